@@ -0,0 +1,55 @@
+#ifndef CPU_RENDERER_HPP
+#define CPU_RENDERER_HPP
+
+#include "Formula.hpp"
+#include "LevelPack.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace game
+{
+	enum class CpuBackend : std::uint32_t
+	{
+		Scalar = 0,
+		Simd,
+		Count
+	};
+
+	// Same mapping as the GPU kernel: pixel (0, 0) is at offset - size, each axis spans 2 * size
+	struct CpuView
+	{
+		double offsetX;
+		double offsetY;
+		double size;
+		std::uint32_t width;
+		std::uint32_t height;
+	};
+
+	struct CpuRenderParams
+	{
+		Formula formula = Formula::Mandelbrot;
+		PrecisionTier precision = PrecisionTier::Double;
+		CpuBackend backend = CpuBackend::Simd;
+		std::int32_t iterations = 60;
+		double bailout = 2.0;
+		FormulaParams formulaParams {};
+
+		// 0 uses every hardware thread
+		std::uint32_t threads = 0;
+
+		// Copy mirrored rows for formulas with a symmetric dwell when the view is centred on
+		// the axis of symmetry. Results can differ from a full render by rounding at the edges.
+		bool exploitSymmetry = true;
+	};
+
+	struct CpuRenderStats
+	{
+		std::uint64_t iterations;
+		std::uint64_t fallbackPixels;
+	};
+
+	// Renders escape iterations for every pixel of the view, row-major with row 0 at offsetY - size
+	CpuRenderStats RenderDwell(const CpuRenderParams& params, const CpuView& view, std::vector<std::int32_t>& dwell);
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef DOUBLE_DOUBLE_HPP
+#define DOUBLE_DOUBLE_HPP
+
+#include <cmath>
+
+namespace game
+{
+	// Unevaluated sum of two doubles, roughly 106 bits of mantissa.
+	// Only the operations the iteration kernels need are provided.
+	struct DoubleDouble
+	{
+		double hi;
+		double lo;
+
+		constexpr DoubleDouble() : hi(0.0), lo(0.0) { }
+		constexpr DoubleDouble(double _hi) : hi(_hi), lo(0.0) { }
+		constexpr DoubleDouble(double _hi, double _lo) : hi(_hi), lo(_lo) { }
+
+		explicit operator double() const { return hi + lo; }
+		explicit operator float() const { return static_cast<float>(hi + lo); }
+	};
+
+	namespace detail
+	{
+		inline DoubleDouble QuickTwoSum(double a, double b)
+		{
+			double s = a + b;
+			return DoubleDouble(s, b - (s - a));
+		}
+
+		inline DoubleDouble TwoSum(double a, double b)
+		{
+			double s = a + b;
+			double v = s - a;
+			return DoubleDouble(s, (a - (s - v)) + (b - v));
+		}
+
+		inline DoubleDouble TwoProd(double a, double b)
+		{
+			double p = a * b;
+			return DoubleDouble(p, std::fma(a, b, -p));
+		}
+	}
+
+	inline DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b)
+	{
+		DoubleDouble s = detail::TwoSum(a.hi, b.hi);
+		DoubleDouble t = detail::TwoSum(a.lo, b.lo);
+		s = detail::QuickTwoSum(s.hi, s.lo + t.hi);
+		return detail::QuickTwoSum(s.hi, s.lo + t.lo);
+	}
+
+	inline DoubleDouble operator-(const DoubleDouble& a)
+	{
+		return DoubleDouble(-a.hi, -a.lo);
+	}
+
+	inline DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b)
+	{
+		return a + (-b);
+	}
+
+	inline DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b)
+	{
+		DoubleDouble p = detail::TwoProd(a.hi, b.hi);
+		return detail::QuickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+	}
+
+	inline bool operator<(const DoubleDouble& a, const DoubleDouble& b)
+	{
+		return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+	}
+
+	inline bool operator>(const DoubleDouble& a, const DoubleDouble& b)
+	{
+		return b < a;
+	}
+
+	inline DoubleDouble Abs(const DoubleDouble& a)
+	{
+		return a.hi < 0.0 ? -a : a;
+	}
+}
+
+#endif
@@ -0,0 +1,411 @@
+#ifndef FORMULA_HPP
+#define FORMULA_HPP
+
+#include "DoubleDouble.hpp"
+#include "LevelPack.hpp"
+#include <cmath>
+
+// CPU versions of the formulas in res/include/formulas.glsl.
+// Each formula is a policy type with static Init() and Step() templates over the real type,
+// so every kernel variant is instantiated from the same definitions with no virtual dispatch.
+
+namespace game
+{
+	inline float Abs(float a) { return std::fabs(a); }
+	inline double Abs(double a) { return std::fabs(a); }
+
+	template <class Real>
+	struct Complex
+	{
+		Real re;
+		Real im;
+	};
+
+	template <class Real>
+	inline Complex<Real> operator+(const Complex<Real>& a, const Complex<Real>& b)
+	{
+		return { a.re + b.re, a.im + b.im };
+	}
+
+	template <class Real>
+	inline Complex<Real> operator-(const Complex<Real>& a, const Complex<Real>& b)
+	{
+		return { a.re - b.re, a.im - b.im };
+	}
+
+	template <class Real>
+	inline Complex<Real> operator*(const Complex<Real>& a, const Complex<Real>& b)
+	{
+		return { a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re };
+	}
+
+	template <class Real>
+	inline Complex<Real> operator*(const Real& s, const Complex<Real>& a)
+	{
+		return { s * a.re, s * a.im };
+	}
+
+	template <class Real>
+	inline Complex<Real> Square(const Complex<Real>& a)
+	{
+		Real twoRe = a.re + a.re;
+		return { a.re * a.re - a.im * a.im, twoRe * a.im };
+	}
+
+	template <class Real>
+	inline Complex<Real> Conjugate(const Complex<Real>& a)
+	{
+		return { a.re, -a.im };
+	}
+
+	template <class Real>
+	inline Real Norm(const Complex<Real>& a)
+	{
+		return a.re * a.re + a.im * a.im;
+	}
+
+	// z^N by repeated squaring, unrolled at compile time
+	template <int N, class Real>
+	inline Complex<Real> Power(const Complex<Real>& z)
+	{
+		static_assert(N >= 1, "Power requires a positive exponent");
+
+		if constexpr (N == 1) return z;
+		else if constexpr (N % 2 == 0) return Square(Power<N / 2>(z));
+		else return Power<N - 1>(z) * z;
+	}
+
+	template <class To, class From>
+	inline Complex<To> ComplexCast(const Complex<From>& a)
+	{
+		return { static_cast<To>(a.re), static_cast<To>(a.im) };
+	}
+
+	// z is the iterated value, w is extra state for formulas that need a second term
+	template <class Real>
+	struct State
+	{
+		Complex<Real> z;
+		Complex<Real> w;
+		Complex<Real> c;
+	};
+
+	// Symmetry of a formula's dwell that renderers can use to skip work
+	enum class Symmetry
+	{
+		None,
+		// dwell(conj(p)) == dwell(p), mirrored across the real axis
+		Conjugate,
+		// dwell(-p) == dwell(p), rotated half a turn around the origin
+		Point,
+	};
+
+	// Values supplied at runtime, only used by formulas that ask for them
+	struct FormulaParams
+	{
+		Complex<double> juliaC;
+	};
+
+	namespace formulas
+	{
+		template <class Real>
+		inline State<Real> Parameter(const Complex<Real>& pos)
+		{
+			return { { Real(0.0), Real(0.0) }, { Real(0.0), Real(0.0) }, pos };
+		}
+
+		template <class Real>
+		inline State<Real> Seed(const Complex<Real>& pos, const Complex<Real>& c)
+		{
+			return { pos, { Real(0.0), Real(0.0) }, c };
+		}
+
+		// |a + b| - |a| without cancellation, used to perturb abs()
+		inline double DiffAbs(double a, double b)
+		{
+			if (a >= 0.0) return a + b >= 0.0 ? b : -(2.0 * a + b);
+			return a + b > 0.0 ? 2.0 * a + b : -b;
+		}
+
+		// Generic perturbation of z' = z^2 + c around a reference orbit
+		inline void PerturbQuadratic(const State<double>& ref, State<double>& delta)
+		{
+			delta.z = (2.0 * ref.z + delta.z) * delta.z + delta.c;
+		}
+
+		// (Z + d)^N - Z^N = sum over k of binomial(N, k) * Z^(N - k) * d^k
+		template <int N>
+		inline Complex<double> PerturbPower(const Complex<double>& Z, const Complex<double>& d)
+		{
+			Complex<double> zPowers[N];
+			zPowers[0] = { 1.0, 0.0 };
+
+			for (int k = 1; k < N; k++)
+			{
+				zPowers[k] = zPowers[k - 1] * Z;
+			}
+
+			Complex<double> sum { 0.0, 0.0 };
+			Complex<double> dPower = d;
+			double binomial = N;
+
+			for (int k = 1; k <= N; k++)
+			{
+				sum = sum + binomial * (zPowers[N - k] * dPower);
+				dPower = dPower * d;
+				binomial = binomial * (N - k) / (k + 1);
+			}
+
+			return sum;
+		}
+	}
+
+	struct Mandelbrot
+	{
+		static constexpr Formula id = Formula::Mandelbrot;
+		static constexpr Symmetry symmetry = Symmetry::Conjugate;
+
+		template <class Real>
+		static State<Real> Init(const Complex<Real>& pos, const FormulaParams&)
+		{
+			return formulas::Parameter(pos);
+		}
+
+		template <class Real>
+		static void Step(State<Real>& s)
+		{
+			s.z = Square(s.z) + s.c;
+		}
+
+		static void Perturb(const State<double>& ref, State<double>& delta)
+		{
+			formulas::PerturbQuadratic(ref, delta);
+		}
+	};
+
+	struct Tricorn
+	{
+		static constexpr Formula id = Formula::Tricorn;
+		static constexpr Symmetry symmetry = Symmetry::Conjugate;
+
+		template <class Real>
+		static State<Real> Init(const Complex<Real>& pos, const FormulaParams&)
+		{
+			return formulas::Parameter(pos);
+		}
+
+		template <class Real>
+		static void Step(State<Real>& s)
+		{
+			s.z = Square(Conjugate(s.z)) + s.c;
+		}
+
+		// conj(Z + d)^2 - conj(Z)^2 = conj(2Zd + d^2)
+		static void Perturb(const State<double>& ref, State<double>& delta)
+		{
+			delta.z = Conjugate((2.0 * ref.z + delta.z) * delta.z) + delta.c;
+		}
+	};
+
+	struct BurningShip
+	{
+		static constexpr Formula id = Formula::BurningShip;
+		static constexpr Symmetry symmetry = Symmetry::None;
+
+		template <class Real>
+		static State<Real> Init(const Complex<Real>& pos, const FormulaParams&)
+		{
+			return formulas::Parameter(pos);
+		}
+
+		template <class Real>
+		static void Step(State<Real>& s)
+		{
+			s.z = Square(Complex<Real> { Abs(s.z.re), Abs(s.z.im) }) + s.c;
+		}
+
+		static void Perturb(const State<double>& ref, State<double>& delta)
+		{
+			const Complex<double>& Z = ref.z;
+			const Complex<double>& d = delta.z;
+			double re = (2.0 * Z.re + d.re) * d.re - (2.0 * Z.im + d.im) * d.im;
+			double im = 2.0 * formulas::DiffAbs(Z.re * Z.im, Z.re * d.im + d.re * Z.im + d.re * d.im);
+			delta.z = Complex<double> { re, im } + delta.c;
+		}
+	};
+
+	// Julia set with c fixed at compile time by a type providing constexpr re and im
+	template <class Constant>
+	struct Julia
+	{
+		static constexpr Formula id = Constant::id;
+		static constexpr Symmetry symmetry = Symmetry::Point;
+
+		template <class Real>
+		static State<Real> Init(const Complex<Real>& pos, const FormulaParams&)
+		{
+			return formulas::Seed(pos, Complex<Real> { Real(Constant::re), Real(Constant::im) });
+		}
+
+		template <class Real>
+		static void Step(State<Real>& s)
+		{
+			s.z = Square(s.z) + s.c;
+		}
+
+		static void Perturb(const State<double>& ref, State<double>& delta)
+		{
+			formulas::PerturbQuadratic(ref, delta);
+		}
+	};
+
+	// Julia set with c taken from FormulaParams
+	struct JuliaRuntime
+	{
+		static constexpr Symmetry symmetry = Symmetry::Point;
+
+		template <class Real>
+		static State<Real> Init(const Complex<Real>& pos, const FormulaParams& params)
+		{
+			return formulas::Seed(pos, ComplexCast<Real>(params.juliaC));
+		}
+
+		template <class Real>
+		static void Step(State<Real>& s)
+		{
+			s.z = Square(s.z) + s.c;
+		}
+
+		static void Perturb(const State<double>& ref, State<double>& delta)
+		{
+			formulas::PerturbQuadratic(ref, delta);
+		}
+	};
+
+	struct Julia0Constant
+	{
+		static constexpr Formula id = Formula::Julia0;
+		static constexpr double re = -0.835;
+		static constexpr double im = 0.2321;
+	};
+
+	struct Julia1Constant
+	{
+		static constexpr Formula id = Formula::Julia1;
+		static constexpr double re = 0.285;
+		static constexpr double im = 0.01;
+	};
+
+	using Julia0 = Julia<Julia0Constant>;
+	using Julia1 = Julia<Julia1Constant>;
+
+	// Two-term recurrence z' = z^2 + c + p * z_prev, seeded with the transposed position
+	struct Julia2
+	{
+		static constexpr Formula id = Formula::Julia2;
+		static constexpr Symmetry symmetry = Symmetry::None;
+		static constexpr double p = -0.47;
+
+		template <class Real>
+		static State<Real> Init(const Complex<Real>& pos, const FormulaParams&)
+		{
+			return formulas::Seed(Complex<Real> { pos.im, pos.re }, Complex<Real> { Real(0.544992), Real(0.0) });
+		}
+
+		template <class Real>
+		static void Step(State<Real>& s)
+		{
+			Complex<Real> tmp = s.z;
+			s.z = Square(s.z) + s.c + Real(p) * s.w;
+			s.w = tmp;
+		}
+
+		static void Perturb(const State<double>& ref, State<double>& delta)
+		{
+			Complex<double> tmp = delta.z;
+			delta.z = (2.0 * ref.z + delta.z) * delta.z + delta.c + p * delta.w;
+			delta.w = tmp;
+		}
+	};
+
+	// Multibrot z' = z^N + c, with (N - 1)-fold rotational symmetry as well as the mirror
+	template <int N>
+	struct Multibrot
+	{
+		static constexpr Formula id = static_cast<Formula>(static_cast<std::uint32_t>(Formula::Multibrot3) + N - 3);
+		static constexpr Symmetry symmetry = Symmetry::Conjugate;
+
+		template <class Real>
+		static State<Real> Init(const Complex<Real>& pos, const FormulaParams&)
+		{
+			return formulas::Parameter(pos);
+		}
+
+		template <class Real>
+		static void Step(State<Real>& s)
+		{
+			s.z = Power<N>(s.z) + s.c;
+		}
+
+		static void Perturb(const State<double>& ref, State<double>& delta)
+		{
+			delta.z = formulas::PerturbPower<N>(ref.z, delta.z) + delta.c;
+		}
+	};
+
+	// Multicorn z' = conj(z)^N + c
+	template <int N>
+	struct Multicorn
+	{
+		static constexpr Formula id = static_cast<Formula>(static_cast<std::uint32_t>(Formula::Multicorn3) + N - 3);
+		static constexpr Symmetry symmetry = Symmetry::Conjugate;
+
+		template <class Real>
+		static State<Real> Init(const Complex<Real>& pos, const FormulaParams&)
+		{
+			return formulas::Parameter(pos);
+		}
+
+		template <class Real>
+		static void Step(State<Real>& s)
+		{
+			s.z = Power<N>(Conjugate(s.z)) + s.c;
+		}
+
+		// conj(Z + d)^N - conj(Z)^N = conj((Z + d)^N - Z^N)
+		static void Perturb(const State<double>& ref, State<double>& delta)
+		{
+			delta.z = Conjugate(formulas::PerturbPower<N>(ref.z, delta.z)) + delta.c;
+		}
+	};
+
+	// Calls f with a policy object for a runtime formula id. This is the only place the
+	// formula is switched on, everything below it is instantiated per policy.
+	template <class Function>
+	auto DispatchFormula(Formula formula, Function&& f)
+	{
+		switch (formula)
+		{
+			case Formula::Tricorn: return f(Tricorn {});
+			case Formula::BurningShip: return f(BurningShip {});
+			case Formula::Julia0: return f(Julia0 {});
+			case Formula::Julia1: return f(Julia1 {});
+			case Formula::Julia2: return f(Julia2 {});
+			case Formula::Multibrot3: return f(Multibrot<3> {});
+			case Formula::Multibrot4: return f(Multibrot<4> {});
+			case Formula::Multibrot5: return f(Multibrot<5> {});
+			case Formula::Multibrot6: return f(Multibrot<6> {});
+			case Formula::Multibrot7: return f(Multibrot<7> {});
+			case Formula::Multibrot8: return f(Multibrot<8> {});
+			case Formula::Multicorn3: return f(Multicorn<3> {});
+			case Formula::Multicorn4: return f(Multicorn<4> {});
+			case Formula::Multicorn5: return f(Multicorn<5> {});
+			case Formula::Multicorn6: return f(Multicorn<6> {});
+			case Formula::Multicorn7: return f(Multicorn<7> {});
+			case Formula::Multicorn8: return f(Multicorn<8> {});
+			default: return f(Mandelbrot {});
+		}
+	}
+}
+
+#endif
@@ -3,84 +3,302 @@
 
 #include "ValkyrieEngine/ValkyrieEngine.hpp"
 #include "ValkyrieEngineCommon/ValkyrieEngineCommon.hpp"
-#include "ValkyrieEngineCommon/Content.hpp"
 #include "VLFW/VLFW.hpp"
+#include "GpuTimers.hpp"
+#include "InputLog.hpp"
+#include "LevelPack.hpp"
+#include "Palette.hpp"
+#include "Shader.hpp"
+#include "ShaderCache.hpp"
+#include "ShaderCompiler.hpp"
 #include <chrono>
+#include <map>
 
 using namespace vlk;
 using namespace vlfw;
 
-struct Level
+namespace game
 {
-	UInt program;
-	float zooms[4];
-	Vector2 offsets[4];
-};
+	// How a level appears and disappears, all are drawn from the cached dwell
+	enum class Transition : UInt
+	{
+		// Reveals the fractal one band of iterations at a time, like raising the iteration count
+		Band = 0,
+		Fade,
+		Dissolve,
+		Count
+	};
 
-#define NUM_LEVELS 12
+	Transition ParseTransition(const std::string& name);
+
+	struct GameOptions
+	{
+		std::string levelPack = "res/levels.pack";
+
+		// Writes every update's input to this file
+		std::string recordPath;
+
+		// Plays back a recorded input log instead of reading the mouse and keyboard,
+		// then prints frame times and quits
+		std::string replayPath;
+
+		// Prints GPU time per section about once a second
+		bool printGpuTimings = false;
+
+		// Frames the CPU may run ahead of the GPU, from 1 (wait for every frame) to 3
+		UInt frameQueueDepth = 2;
+
+		// Only render when something on screen changed, and sleep while idle
+		bool renderOnDemand = true;
+
+		// GPU milliseconds of fractal work per frame. Above 0 the fractal is rendered a batch of
+		// tiles per frame and completes over several, 0 renders it whole every time.
+		float frameBudget = 0.f;
+
+		// GPU milliseconds the fractal may take per frame while the camera moves. The render
+		// scale drops to meet it and returns to full once the camera stops. 0 always renders
+		// at full resolution, as does a frame budget.
+		float resolutionTarget = 0.f;
+
+		// Supersamples the boundaries of the fractal once the camera stops
+		bool supersample = false;
+		// Dwell difference between neighbours that makes a boundary, escaped pixels next to
+		// ones that never escaped always do
+		Int boundaryThreshold = 2;
+
+		// Jittered frames averaged into the view once the camera stops, one per frame. 0 keeps
+		// a single sample, as does a frame budget.
+		UInt accumulateFrames = 0;
+
+		// Kernel variant used for every level, the formula and precision come from the level
+		KernelConfig kernel;
+
+		// Starting palette, P switches to the next one
+		Palette palette = Palette::Hue;
+		// Palette repeats per second the colours cycle by, 0 keeps them still
+		float paletteCycle = 0.f;
+		// Dwell covered by one repeat of the palette
+		float palettePeriod = 50.f;
+
+		Transition transition = Transition::Band;
+	};
+
+	constexpr UInt MAX_FRAMES_IN_FLIGHT = 3;
+
+	// A point on the fractal's plane. Kept in double like the level pack, float runs out of
+	// precision long before double precision kernels do.
+	struct WorldPoint
+	{
+		double x = 0.0;
+		double y = 0.0;
+	};
+
+	// Everything the fractal dispatch depends on
+	struct FractalState
+	{
+		UInt program = 0;
+		UInt iterations = 0;
+		double zoom = 0.0;
+		WorldPoint offset;
+		// Fraction of viewSize rendered along each axis
+		float scale = 1.f;
+	};
+
+	struct Level
+	{
+		Formula formula;
+		PrecisionTier precision;
+		UInt iterationBudget;
+		double zooms[4];
+		WorldPoint offsets[4];
+	};
+
+	// The next level, prepared a slice at a time while the current one is played so that
+	// starting it only swaps textures
+	struct LevelPrefetch
+	{
+		bool active = false;
+		UInt level = 0;
+		Level data;
+		KernelConfig kernel;
+		KernelConfig previewKernel;
+		UInt programJob = 0;
+		UInt previewProgramJob = 0;
+
+		// Its starting view and previews, swapped with the current level's when it starts
+		UInt output = 0;
+		UInt previewArray = 0;
+		UInt bakedPreviews[4] = {};
+		bool previewBaked[4] = {};
+
+		// Previews prepared so far, one per slice
+		UInt previews = 0;
+		// Rows of the starting view rendered so far
+		UInt rows = 0;
+	};
 
-namespace game
-{
 	class Game final :
 		public EventListener<UpdateEvent>,
 		public EventListener<VLFWMain::RenderWaitEvent>,
 		public EventListener<PostUpdateEvent>
 	{
 		Window* window;
+		ShaderCache shaderCache;
+		ShaderCompiler shaderCompiler;
 		UInt currentProgram;
-		UInt fractalOutput;
+		// One output per frame in flight, so a frame can render while the last is displayed
+		UInt fractalOutputs[MAX_FRAMES_IN_FLIGHT];
+		GLsync frameFences[MAX_FRAMES_IN_FLIGHT];
+		UInt frameQueueDepth;
+		UInt frameIndex;
+
+		KernelConfig kernelConfig;
+		KernelConfig levelKernel;
+		// levelKernel rendering all previews in one layered dispatch
+		KernelConfig previewKernel;
+		UInt previewKernelProgram;
+		WorkQueue workQueue;
+
+		bool renderOnDemand;
+		bool fractalValid;
+		FractalState renderedState;
+
+		float frameBudget;
+		// The image being rendered a batch of tiles at a time, and the tiles it still needs.
+		// A change of view restarts the count but not the position, so tiles keep being
+		// refreshed in turn while the view keeps changing.
+		FractalState tiledState;
+		UInt tilesLeft;
+		UInt nextTile;
+
+		float resolutionTarget;
+		// Scale of the image in displayedOutput
+		float displayedScale;
+		// The view asked for by the last frame, to tell when the camera moves
+		FractalState requestedState;
+
+		bool supersample;
+		Int boundaryThreshold;
+		// Samples of the boundary pixels, and the index of every pixel's samples
+		UInt boundaryBuffer;
+		UInt boundaryCapacity;
+		UInt sampleIndexTexture;
+		// Whether they belong to the image in displayedOutput
+		bool supersampleValid;
+
+		UInt accumulateFrames;
+		// Sum of the colours of every frame accumulated for the image in displayedOutput
+		UInt accumulationTexture;
+		UInt accumulationFramebuffer;
+		// Dwell of the jittered frame being accumulated
+		UInt jitterOutput;
+		UInt accumulatedFrames;
+		UInt displayedOutput;
+		Vector2 presentedSize;
+		// Whether anything on screen changed this frame, frames where nothing did sleep
+		bool screenChanged;
 		UInt quadProgram;
-		UInt tricornProgram;
-		UInt juliaProgram0;
-		UInt juliaProgram1;
-		UInt juliaProgram2;
-		UInt mandelProgram;
-		UInt burningProgram;
+		// Draws dwell textures, quadProgram draws textures that are already coloured
+		UInt colorizeProgram;
+		// colorizeProgram for the layers of previewArray, one instance per layer
+		UInt previewProgram;
+		UInt paletteTextures[static_cast<UInt>(Palette::Count)];
+		Palette palette;
+		float paletteOffset;
+		float paletteCycle;
+		float palettePeriod;
+		std::map<std::string, UInt> programJobs;
 		UInt endTexture;
 		UInt quadVAO;
 		UInt computeVAO;
 
 		UInt currentLevel;
-		UInt numIterations;
-		UInt previewTextures[4];
+		Transition transition;
+		// 0 when the level is hidden, 1 once it's fully shown
+		float transitionProgress;
+		UInt previewArray;
+		UInt previewViewBuffer;
+		UInt bakedPreviews[4];
+		bool previewBaked[4];
 		bool foundImages[4];
 		Color texColors[4];
 		bool gameWon;
 
-		float zoomValue;
+		double zoomValue;
 		Vector2 dragStart;
-		Vector2 viewOffset;
+		WorldPoint viewOffset;
 
 		Vector2 fullSize;
 		Vector2 viewSize;
 		Vector2 previewSize;
 
-		Level levels[NUM_LEVELS];
+		LevelPack levelPack;
+		Level level;
+		LevelPrefetch prefetch;
+
+		InputRecorder inputRecorder;
+		InputReplay inputReplay;
+		bool replaying;
+		std::vector<double> replayFrameTimes;
+		std::chrono::steady_clock::time_point lastUpdate;
+
+		GpuTimers gpuTimers;
+		bool printGpuTimings;
+		std::chrono::steady_clock::time_point lastGpuReport;
+
+		void PrintGpuMetrics() const;
+
+		// Palette and transition uniforms shared by the colorize programs, with the program bound
+		void SetColorizeUniforms(float progress);
 
 		public:
-		Game(Window* _window);
+		Game(Window* _window, const GameOptions& options);
 		~Game();
 		void OnEvent(const UpdateEvent&) override;
 		void OnEvent(const VLFWMain::RenderWaitEvent&) override;
 		void OnEvent(const PostUpdateEvent&) override;
 
+		// Returns the compiler job for a kernel variant, queueing it if it's new
+		UInt QueueProgram(const KernelConfig& config);
+
 		void LoadLevel();
 		void GeneratePreviews();
-	};
 
-	struct GLSLFile
-	{
-		std::string data;
-	};
-}
+		// Starts preparing the level after the current one, if there is one
+		void StartPrefetch();
+		// Renders the next slice of the prefetch unless its programs are still compiling.
+		// Returns whether any work was issued.
+		bool PrefetchSlice();
+		bool PrefetchDone() const;
+		// Finishes the prefetch, blocking if needed, and makes it the current level
+		void StartPrefetchedLevel();
+		// Releases everything the prefetch holds
+		void EvictPrefetch();
 
-namespace vlk
-{
-	template <>
-	game::GLSLFile* ConstructContent(const std::string& path);
+		// Forces the fractal and the screen to be drawn again
+		void Invalidate();
+
+		// Renders as many tiles of the fractal into output as the frame budget allows, with
+		// the program and view bound. Returns whether the image is complete.
+		bool RenderTiles(const FractalState& state, UInt output);
+
+		// Picks the render scale that meets the resolution target at the measured cost per pixel
+		float RenderScale(bool moving) const;
+
+		// Supersamples the boundaries of the complete image in displayedOutput, unless the
+		// program is still compiling. Returns whether it did.
+		bool Supersample();
 
-	template <>
-	void DestroyContent(game::GLSLFile* file);
+		// Adds the next jittered frame of the complete image in displayedOutput to the
+		// accumulation, unless it has all of them. Returns whether it did.
+		bool Accumulate();
+
+		// Polls the mouse and keyboard, or takes the next frame of a replay
+		InputFrame ReadInput();
+		void FinishReplay();
+
+		const GpuMetrics& GetGpuMetrics() const { return gpuTimers.GetMetrics(); }
+	};
 }
 
 #endif
@@ -0,0 +1,87 @@
+#ifndef GPU_TIMERS_HPP
+#define GPU_TIMERS_HPP
+
+#include "ValkyrieEngine/ValkyrieEngine.hpp"
+
+using namespace vlk;
+
+namespace game
+{
+	enum class GpuSection : UInt
+	{
+		Fractal = 0,
+		Previews,
+		Present,
+		// Slices of the next level rendered in the background
+		Prefetch,
+		// Extra samples along the boundaries of a still view
+		Supersample,
+		// Jittered frames averaged into a still view
+		Accumulate,
+		Count
+	};
+
+	const char* GpuSectionName(GpuSection section);
+
+	// Moving averages of the GPU time spent per frame, in milliseconds
+	struct GpuMetrics
+	{
+		double sectionMs[static_cast<UInt>(GpuSection::Count)] = {};
+		// Time per unit of work, for sections that report how much they did
+		double workMs[static_cast<UInt>(GpuSection::Count)] = {};
+		double frameMs = 0.0;
+		UInt frames = 0;
+		// Frames whose queries weren't ready when their slot came round again
+		UInt dropped = 0;
+	};
+
+	// Ring of timer queries, one set per frame in flight. Results are collected when a
+	// frame's slot is reused a few frames later, so reading them never stalls the pipeline.
+	class GpuTimers
+	{
+		static constexpr UInt FRAMES_IN_FLIGHT = 4;
+		static constexpr UInt SECTION_COUNT = static_cast<UInt>(GpuSection::Count);
+
+		struct Frame
+		{
+			UInt sections[SECTION_COUNT];
+			bool used[SECTION_COUNT];
+			UInt work[SECTION_COUNT];
+			UInt begin;
+			UInt end;
+			bool pending;
+		};
+
+		Frame frames[FRAMES_IN_FLIGHT];
+		UInt current;
+		UInt sectionSamples[SECTION_COUNT];
+		UInt workSamples[SECTION_COUNT];
+		bool frameOpen;
+		bool sectionOpen;
+		GpuMetrics metrics;
+
+		void Collect(Frame& frame);
+
+		public:
+		GpuTimers();
+		~GpuTimers();
+
+		GpuTimers(const GpuTimers&) = delete;
+		GpuTimers& operator=(const GpuTimers&) = delete;
+
+		// Creates the queries, needs a current GL context
+		void Init();
+
+		void BeginFrame();
+		void EndFrame();
+
+		// Sections may not overlap, each can be timed once per frame. Work is how many units,
+		// such as tiles, the section covers.
+		void Begin(GpuSection section, UInt work = 0);
+		void End();
+
+		const GpuMetrics& GetMetrics() const { return metrics; }
+	};
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef INPUT_LOG_HPP
+#define INPUT_LOG_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace game
+{
+	namespace InputButtons
+	{
+		constexpr std::uint8_t LeftPressed = 1 << 0;
+		constexpr std::uint8_t RightDown = 1 << 1;
+		constexpr std::uint8_t MiddleDown = 1 << 2;
+	}
+
+	namespace InputKeys
+	{
+		constexpr std::uint8_t Escape = 1 << 0;
+		// Num1 to Num4 follow in consecutive bits
+		constexpr std::uint8_t Num1 = 1 << 1;
+		constexpr std::uint8_t NextPalette = 1 << 5;
+	}
+
+	// Everything the game reads from the mouse and keyboard in one update
+	struct InputFrame
+	{
+		float scroll = 0.f;
+		float mouseDelta[2] = { 0.f, 0.f };
+		float mousePos[2] = { 0.f, 0.f };
+		std::uint8_t buttons = 0;
+		std::uint8_t keys = 0;
+
+		// Time since the previous update when recorded
+		std::uint32_t frameMicros = 0;
+	};
+
+	// Input log layout (little-endian):
+	//   InputLogHeader
+	//   frames until the end of the file, each:
+	//     u8 field mask, varint frameMicros, then only the fields in the mask
+	// Idle frames take two or three bytes.
+
+	constexpr char INPUT_LOG_MAGIC[4] = { 'F', 'F', 'I', 'R' };
+	constexpr std::uint32_t INPUT_LOG_VERSION = 1;
+
+	struct InputLogHeader
+	{
+		char magic[4];
+		std::uint32_t version;
+		// Mouse positions and deltas only replay the same on a view of the same size
+		std::uint32_t viewWidth;
+		std::uint32_t viewHeight;
+	};
+
+	static_assert(sizeof(InputLogHeader) == 16, "InputLogHeader layout changed");
+
+	class InputRecorder
+	{
+		std::ofstream file;
+
+		public:
+		void Open(const std::string& path, std::uint32_t viewWidth, std::uint32_t viewHeight);
+		bool IsOpen() const { return file.is_open(); }
+		void Record(const InputFrame& frame);
+		void Close();
+	};
+
+	class InputReplay
+	{
+		std::vector<InputFrame> frames;
+		std::size_t position = 0;
+		InputLogHeader header {};
+
+		public:
+		void Open(const std::string& path);
+		bool IsOpen() const { return !frames.empty(); }
+		const InputLogHeader& GetHeader() const { return header; }
+		std::size_t GetFrameCount() const { return frames.size(); }
+
+		// Returns false once every frame has been played
+		bool Next(InputFrame& frame);
+	};
+}
+
+#endif
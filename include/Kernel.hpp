@@ -0,0 +1,169 @@
+#ifndef KERNEL_HPP
+#define KERNEL_HPP
+
+#include "Formula.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace game
+{
+	// Iterates Lanes pixels in lockstep with independent escape masks.
+	// Escape values follow the GPU kernel: the first iteration at which |z| exceeds the
+	// bailout, or 0 if it never does. The GPU kernel records points that escape straight
+	// away on the following iteration, so those report 1. Returns the number of iterations performed.
+	// With Lanes > 1 the inner loops have a fixed trip count so they can be vectorised.
+	template <class F, class Real, int Lanes>
+	std::uint64_t Iterate(
+		const Complex<Real> (&pos)[Lanes],
+		const FormulaParams& params,
+		std::int32_t iterations,
+		double bailout,
+		std::int32_t (&escape)[Lanes])
+	{
+		State<Real> s[Lanes];
+		bool active[Lanes];
+		const Real limit = Real(bailout * bailout);
+
+		for (int l = 0; l < Lanes; l++)
+		{
+			s[l] = F::Init(pos[l], params);
+			active[l] = true;
+			escape[l] = 0;
+		}
+
+		std::int32_t i = 0;
+
+		for (; i < iterations; i++)
+		{
+			bool any = false;
+
+			for (int l = 0; l < Lanes; l++)
+			{
+				F::Step(s[l]);
+
+				bool escaped = active[l] && Norm(s[l].z) > limit;
+				escape[l] = escaped ? std::max<std::int32_t>(i, 1) : escape[l];
+				active[l] = active[l] && !escaped;
+				any = any || active[l];
+			}
+
+			if (!any)
+			{
+				i++;
+				break;
+			}
+		}
+
+		return static_cast<std::uint64_t>(i) * Lanes;
+	}
+
+	// Orbit of a single point at double-double precision, rounded to double for perturbation
+	template <class F>
+	struct ReferenceOrbit
+	{
+		Complex<DoubleDouble> pos;
+		State<DoubleDouble> init;
+		std::vector<State<double>> orbit;
+
+		ReferenceOrbit(const Complex<DoubleDouble>& _pos, const FormulaParams& params, std::int32_t iterations, double bailout) :
+			pos(_pos),
+			init(F::Init(_pos, params))
+		{
+			State<DoubleDouble> s = init;
+			orbit.reserve(static_cast<std::size_t>(iterations) + 1);
+			orbit.push_back(Round(s));
+
+			// Stop a little after escaping, pixels that outlive the reference fall back to full precision
+			const double limit = bailout * bailout * 16.0;
+
+			for (std::int32_t i = 0; i < iterations; i++)
+			{
+				F::Step(s);
+				orbit.push_back(Round(s));
+				if (Norm(orbit.back().z) > limit) break;
+			}
+		}
+
+		static State<double> Round(const State<DoubleDouble>& s)
+		{
+			return { ComplexCast<double>(s.z), ComplexCast<double>(s.w), ComplexCast<double>(s.c) };
+		}
+	};
+
+	// Iterates Lanes pixels as double precision offsets from a reference orbit.
+	// Lanes that glitch or outlive the reference are flagged in needsFallback and must be
+	// recomputed directly. Returns the number of iterations performed.
+	template <class F, int Lanes>
+	std::uint64_t Perturb(
+		const ReferenceOrbit<F>& reference,
+		const Complex<DoubleDouble> (&pos)[Lanes],
+		const FormulaParams& params,
+		std::int32_t iterations,
+		double bailout,
+		std::int32_t (&escape)[Lanes],
+		bool (&needsFallback)[Lanes])
+	{
+		State<double> delta[Lanes];
+		bool active[Lanes];
+		const double limit = bailout * bailout;
+
+		// Glitches show up as the full orbit getting much closer to 0 than the reference
+		constexpr double glitchTolerance = 1e-6;
+
+		for (int l = 0; l < Lanes; l++)
+		{
+			State<DoubleDouble> s = F::Init(pos[l], params);
+			delta[l].z = ComplexCast<double>(s.z - reference.init.z);
+			delta[l].w = ComplexCast<double>(s.w - reference.init.w);
+			delta[l].c = ComplexCast<double>(s.c - reference.init.c);
+			active[l] = true;
+			escape[l] = 0;
+			needsFallback[l] = false;
+		}
+
+		const std::int32_t length = static_cast<std::int32_t>(reference.orbit.size()) - 1;
+		std::int32_t i = 0;
+
+		for (; i < iterations; i++)
+		{
+			if (i >= length)
+			{
+				for (int l = 0; l < Lanes; l++)
+				{
+					needsFallback[l] = needsFallback[l] || active[l];
+				}
+
+				break;
+			}
+
+			const State<double>& ref = reference.orbit[i];
+			const Complex<double>& next = reference.orbit[i + 1].z;
+			bool any = false;
+
+			for (int l = 0; l < Lanes; l++)
+			{
+				F::Perturb(ref, delta[l]);
+
+				double norm = Norm(next + delta[l].z);
+				bool escaped = active[l] && norm > limit;
+				bool glitched = active[l] && !escaped && norm < glitchTolerance * Norm(next);
+
+				escape[l] = escaped ? std::max<std::int32_t>(i, 1) : escape[l];
+				needsFallback[l] = needsFallback[l] || glitched;
+				active[l] = active[l] && !escaped && !glitched;
+				any = any || active[l];
+			}
+
+			if (!any)
+			{
+				i++;
+				break;
+			}
+		}
+
+		return static_cast<std::uint64_t>(i) * Lanes;
+	}
+}
+
+#endif
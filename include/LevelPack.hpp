@@ -0,0 +1,145 @@
+#ifndef LEVEL_PACK_HPP
+#define LEVEL_PACK_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace game
+{
+	enum class Formula : std::uint32_t
+	{
+		Mandelbrot = 0,
+		Tricorn,
+		BurningShip,
+		Julia0,
+		Julia1,
+		Julia2,
+		Multibrot3,
+		Multibrot4,
+		Multibrot5,
+		Multibrot6,
+		Multibrot7,
+		Multibrot8,
+		Multicorn3,
+		Multicorn4,
+		Multicorn5,
+		Multicorn6,
+		Multicorn7,
+		Multicorn8,
+		Count
+	};
+
+	enum class PrecisionTier : std::uint32_t
+	{
+		Float = 0,
+		Double,
+		DoubleDouble,
+		Perturbation,
+		Count
+	};
+
+	enum class AssetFormat : std::uint32_t
+	{
+		None = 0,
+		RGBA8,
+	};
+
+	// Level pack layout (little-endian):
+	//   LevelPackHeader
+	//   LevelIndexEntry[levelCount]   at header.indexOffset
+	//   LevelRecord                   at each entry.recordOffset
+	//   asset blobs                   at each record.previews[i].offset
+	// Every structure is 8-byte aligned so records can be read straight out of the mapping.
+
+	constexpr char LEVEL_PACK_MAGIC[4] = { 'F', 'F', 'L', 'P' };
+	constexpr std::uint32_t LEVEL_PACK_VERSION = 1;
+
+	// Dwell is rendered into 16 bit textures, budgets past this can't be told apart
+	constexpr std::uint32_t MAX_ITERATION_BUDGET = 65535;
+
+	struct LevelPackHeader
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t headerSize;
+		std::uint32_t levelCount;
+		std::uint64_t indexOffset;
+		std::uint64_t fileSize;
+	};
+
+	struct LevelIndexEntry
+	{
+		std::uint64_t recordOffset;
+		std::uint64_t recordSize;
+	};
+
+	struct AssetRef
+	{
+		std::uint64_t offset;
+		std::uint32_t size;
+		AssetFormat format;
+		std::uint32_t width;
+		std::uint32_t height;
+	};
+
+	struct LevelRecord
+	{
+		Formula formula;
+		PrecisionTier precision;
+		std::uint32_t iterationBudget;
+		std::uint32_t flags;
+		double zooms[4];
+		double offsets[4][2];
+		AssetRef previews[4];
+	};
+
+	static_assert(sizeof(LevelPackHeader) == 32, "LevelPackHeader layout changed");
+	static_assert(sizeof(LevelIndexEntry) == 16, "LevelIndexEntry layout changed");
+	static_assert(sizeof(AssetRef) == 24, "AssetRef layout changed");
+	static_assert(sizeof(LevelRecord) == 208, "LevelRecord layout changed");
+
+	// Read-only, memory-mapped view of a level pack.
+	// Opening a pack only validates the header, levels are resolved when they are requested.
+	class LevelPack final
+	{
+		const std::uint8_t* data;
+		std::size_t size;
+		void* mapping;
+
+		const LevelPackHeader* Header() const;
+
+		public:
+		LevelPack();
+		~LevelPack();
+		LevelPack(const LevelPack&) = delete;
+		LevelPack& operator=(const LevelPack&) = delete;
+
+		bool Open(const std::string& path);
+		void Close();
+
+		std::uint32_t GetLevelCount() const;
+		const LevelRecord& GetLevel(std::uint32_t index) const;
+
+		// Returns nullptr if the level has no baked asset in that slot
+		const std::uint8_t* GetPreviewAsset(std::uint32_t index, std::uint32_t slot) const;
+	};
+
+	// Source description of a level, used by tools to write packs
+	struct LevelDesc
+	{
+		LevelRecord record;
+		std::vector<std::uint8_t> previews[4];
+	};
+
+	void WriteLevelPack(const std::string& path, const std::vector<LevelDesc>& levels);
+
+	Formula ParseFormula(const std::string& name);
+	PrecisionTier ParsePrecisionTier(const std::string& name);
+
+	// Names as written in level lists
+	const char* FormulaName(Formula formula);
+	const char* PrecisionTierName(PrecisionTier tier);
+}
+
+#endif
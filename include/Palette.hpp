@@ -0,0 +1,28 @@
+#ifndef PALETTE_HPP
+#define PALETTE_HPP
+
+#include "ValkyrieEngine/ValkyrieEngine.hpp"
+#include <string>
+
+using namespace vlk;
+
+namespace game
+{
+	// Colour gradients the dwell is mapped through when drawing, each repeats seamlessly
+	enum class Palette : UInt
+	{
+		Hue = 0,
+		Fire,
+		Ocean,
+		Grayscale,
+		Count
+	};
+
+	Palette ParsePalette(const std::string& name);
+	const char* PaletteName(Palette palette);
+
+	// Samples a palette into a repeating, linearly filtered 1D texture. Needs a current GL context.
+	UInt CreatePaletteTexture(Palette palette);
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SHADER_HPP
+#define SHADER_HPP
+
+#include "ValkyrieEngine/ValkyrieEngine.hpp"
+#include "ValkyrieEngineCommon/Content.hpp"
+#include "LevelPack.hpp"
+#include "ShaderCache.hpp"
+#include "WorkQueue.hpp"
+#include <cstddef>
+#include <string>
+
+using namespace vlk;
+
+namespace game
+{
+	// GLSL source with its #include directives already resolved
+	struct GLSLFile
+	{
+		std::string data;
+	};
+
+	// How the fractal kernel's work is spread over the GPU
+	enum class DispatchMode : UInt
+	{
+		// One invocation per ILP_FACTOR pixels over the whole image
+		Grid = 0,
+		// Every pixel up to a small cap, then an indirect dispatch over the pixels still iterating
+		TwoPass,
+		// A fixed number of workgroups pulling tiles from an atomic counter until the image is done
+		Persistent,
+		Count
+	};
+
+	DispatchMode ParseDispatchMode(const std::string& name);
+	const char* DispatchModeName(DispatchMode mode);
+
+	// Compile-time parameters of the fractal kernel, injected as #defines
+	struct KernelConfig
+	{
+		Formula formula = Formula::Mandelbrot;
+		PrecisionTier precision = PrecisionTier::Float;
+		UInt workgroupSizeX = 8;
+		UInt workgroupSizeY = 8;
+		UInt ilpFactor = 1;
+		float bailout = 2.f;
+		DispatchMode dispatchMode = DispatchMode::Grid;
+		// Iterations of a two-pass dispatch's first pass
+		UInt firstPassIterations = 64;
+		// Workgroups launched by a persistent dispatch, enough to keep a large desktop GPU busy
+		UInt persistentGroups = 256;
+		// Renders up to MAX_KERNEL_LAYERS views into a texture array, taken from a uniform
+		// buffer, in a single grid dispatch
+		bool layered = false;
+		// Takes SUPERSAMPLES jittered samples in the boundary pixels of an image the kernel
+		// already rendered, in two grid dispatches, see DispatchSupersample
+		bool supersample = false;
+
+		std::string Defines() const;
+
+		// Parses a workgroup size written as <x>x<y>, such as 16x16
+		void SetWorkgroupSize(const std::string& size);
+	};
+
+	constexpr UInt MAX_KERNEL_LAYERS = 4;
+
+	// Samples a supersampling kernel takes in every boundary pixel, a square number
+	constexpr UInt SUPERSAMPLES = 16;
+
+	// Dispatches a kernel built from config over a width x height image, with the
+	// program already bound. The queue is only used by the modes that need scratch storage.
+	// Layered kernels cover that many layers.
+	void DispatchKernel(const KernelConfig& config, WorkQueue& queue, UInt width, UInt height, UInt layers = 1);
+
+	// Like DispatchKernel, but only renders the regionWidth x regionHeight pixels at x, y.
+	// The view still spans the whole width x height image.
+	void DispatchRegion(const KernelConfig& config, WorkQueue& queue, UInt width, UInt height, UInt x, UInt y, UInt regionWidth, UInt regionHeight, UInt layers = 1);
+
+	// Bytes of the boundary buffer a supersampling kernel needs for up to capacity pixels
+	std::size_t BoundaryBufferSize(UInt capacity);
+
+	// Supersamples the pixels of a width x height image whose dwell differs from a neighbour's
+	// by more than threshold, with a kernel built with supersample set already bound. The image
+	// is read from image unit 0. Up to capacity pixels get their samples in the boundary buffer,
+	// and the r32ui image in unit 2 gets every pixel's index + 1 in it, or 0.
+	void DispatchSupersample(const KernelConfig& config, UInt boundaryBuffer, UInt capacity, Int threshold, UInt width, UInt height);
+
+	// The GPU kernels only come in float and double, higher tiers run at double precision
+	PrecisionTier GpuPrecision(PrecisionTier tier);
+
+	void LoadShader(const std::string& path, const std::string& alias);
+
+	UInt CreateComputeProgram(const ShaderCache& cache, const std::string& source, const std::string& defines = "");
+	// The defines go into both stages
+	UInt CreateGraphicsProgram(const ShaderCache& cache, const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines = "");
+}
+
+namespace vlk
+{
+	template <>
+	game::GLSLFile* ConstructContent(const std::string& path);
+
+	template <>
+	void DestroyContent(game::GLSLFile* file);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef SHADER_CACHE_HPP
+#define SHADER_CACHE_HPP
+
+#include "ValkyrieEngine/ValkyrieEngine.hpp"
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+using namespace vlk;
+
+namespace game
+{
+	// Stores linked program binaries on disk so later launches can skip compilation.
+	// Entries are keyed by a hash of the shader sources and the GL vendor, renderer and
+	// version strings, so a driver update invalidates them automatically.
+	// Requires a current GL context for its whole lifetime.
+	class ShaderCache final
+	{
+		std::string directory;
+		std::string driver;
+		bool enabled;
+
+		std::string PathOf(std::uint64_t key) const;
+
+		public:
+		// Relative directories are taken from the working directory, like res/
+		ShaderCache(const std::string& directory);
+
+		std::uint64_t Key(std::initializer_list<const std::string*> sources) const;
+
+		// Returns 0 if there is no entry or the driver rejected it
+		UInt Load(std::uint64_t key) const;
+		void Store(std::uint64_t key, UInt program) const;
+
+		bool IsEnabled() const { return enabled; }
+	};
+}
+
+#endif
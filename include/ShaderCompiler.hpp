@@ -0,0 +1,72 @@
+#ifndef SHADER_COMPILER_HPP
+#define SHADER_COMPILER_HPP
+
+#include "ValkyrieEngine/ValkyrieEngine.hpp"
+#include "VLFW/VLFW.hpp"
+#include "glad/glad.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace vlk;
+using namespace vlfw;
+
+namespace game
+{
+	// Compiles programs on a worker thread that owns a context shared with the main one.
+	// Finished programs are published with a fence that the main context waits on before first use.
+	// Programs that are requested before the worker gets to them are compiled on the calling thread.
+	class ShaderCompiler final
+	{
+		enum class JobState
+		{
+			Queued,
+			Compiling,
+			Done,
+		};
+
+		struct Job
+		{
+			std::function<UInt()> compile;
+			JobState state;
+			UInt program;
+			GLsync fence;
+			std::exception_ptr error;
+		};
+
+		Window* context;
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<UInt> queue;
+		std::deque<Job> jobs;
+		bool stopping;
+
+		void Run();
+
+		public:
+		// A null context disables the worker, programs are then compiled when they're first requested
+		ShaderCompiler(Window* sharedContext);
+		~ShaderCompiler();
+		ShaderCompiler(const ShaderCompiler&) = delete;
+		ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+		// Queues a program for compilation and returns a handle for Get()
+		UInt Add(std::function<UInt()> compile);
+
+		// Starts compiling queued programs in the background
+		void Start();
+
+		// Without a worker, compiles the program on the calling thread and returns true
+		bool IsReady(UInt job);
+
+		// Returns the compiled program, blocking only if it isn't ready yet
+		UInt Get(UInt job);
+	};
+}
+
+#endif
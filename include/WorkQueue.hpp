@@ -0,0 +1,36 @@
+#ifndef WORK_QUEUE_HPP
+#define WORK_QUEUE_HPP
+
+#include "ValkyrieEngine/ValkyrieEngine.hpp"
+#include "LevelPack.hpp"
+#include <cstddef>
+
+using namespace vlk;
+
+namespace game
+{
+	// Shader storage for work the fractal kernel hands from one pass to the next. Starts with
+	// a header of indirect dispatch arguments and an item count, followed by the items.
+	class WorkQueue
+	{
+		UInt buffer;
+		std::size_t capacity;
+
+		public:
+		WorkQueue();
+		~WorkQueue();
+
+		WorkQueue(const WorkQueue&) = delete;
+		WorkQueue& operator=(const WorkQueue&) = delete;
+
+		// Grows the buffer to hold an item for every pixel, needs a current GL context
+		void Reserve(UInt pixels, PrecisionTier precision);
+
+		// Resets the header to an empty queue and a dispatch of no groups
+		void Clear();
+
+		UInt GetBuffer() const { return buffer; }
+	};
+}
+
+#endif
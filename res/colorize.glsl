@@ -0,0 +1,154 @@
+#version 430
+
+// Turns the dwell written by the fractal kernel into colour
+
+// Values must match game::Transition
+#define TRANSITION_BAND 0
+#define TRANSITION_FADE 1
+#define TRANSITION_DISSOLVE 2
+
+layout(location = 0) in vec2 fragUV;
+
+#ifdef LAYERED
+layout(location = 1) flat in int fragLayer;
+layout(location = 0) uniform usampler2DArray dwellTexture;
+// Tint of every layer
+layout(location = 10) uniform vec4 layerColors[4];
+#else
+layout(location = 0) uniform usampler2D dwellTexture;
+layout(location = 2) uniform vec4 color;
+// Texels of dwellTexture holding the image, from the corner. Images rendered at a reduced
+// scale are smaller than the texture and get upscaled.
+layout(location = 15) uniform ivec2 renderSize;
+// How far the upscale pushes each pixel away from the mean of its taps, 0 is plain bilinear
+layout(location = 16) uniform float sharpness;
+
+#ifdef SUPERSAMPLES
+// Written by the supersampling fractal kernel, see fractal.glsl
+struct BoundaryPixel
+{
+	ivec2 pixel;
+	uint dwell[SUPERSAMPLES / 2];
+};
+
+layout(std430, binding = 1) readonly buffer Boundary
+{
+	uint boundaryGroups[3];
+	uint boundaryCount;
+	BoundaryPixel boundary[];
+};
+
+// Index + 1 into boundary of every supersampled texel, 0 for the rest
+layout(location = 17) uniform usampler2D sampleIndex;
+// Whether sampleIndex and boundary belong to the image in dwellTexture
+layout(location = 18) uniform bool supersampled;
+#endif
+
+#endif
+
+// Repeating gradient, see game::Palette
+layout(location = 3) uniform sampler1D palette;
+// Shifts the gradient along the dwell, animating it cycles the colours
+layout(location = 4) uniform float paletteOffset;
+// Dwell covered by one repeat of the gradient
+layout(location = 5) uniform float palettePeriod;
+layout(location = 6) uniform int transition;
+// 0 hides the fractal, 1 shows all of it
+layout(location = 7) uniform float transitionProgress;
+// Iterations the dwell was rendered with
+layout(location = 8) uniform float iterationBudget;
+
+out vec4 fragColor;
+
+// Stable per-pixel noise in [0, 1)
+float Hash(vec2 p)
+{
+	return fract(sin(dot(p, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+vec3 Shade(uint dwell)
+{
+	// 0 means the pixel never escaped
+	bool shown = dwell > 0;
+
+	if (transition == TRANSITION_BAND)
+	{
+		// Same as rendering with the iteration count scaled down, later escapes look like the interior
+		shown = shown && float(dwell) < floor(transitionProgress * iterationBudget + 0.5);
+	}
+	else if (transition == TRANSITION_DISSOLVE)
+	{
+		shown = shown && Hash(gl_FragCoord.xy) < transitionProgress;
+	}
+
+	return shown ? texture(palette, float(dwell) / palettePeriod + paletteOffset).rgb : vec3(0.0, 0.0, 0.0);
+}
+
+#ifndef LAYERED
+
+#ifdef SUPERSAMPLES
+
+// Mean colour of a supersampled texel's samples
+vec3 ShadeSamples(uint item)
+{
+	vec3 sum = vec3(0.0);
+
+	for (int j = 0; j < SUPERSAMPLES; j++)
+	{
+		sum += Shade((boundary[item].dwell[j / 2] >> (16 * (j % 2))) & 0xFFFFu);
+	}
+
+	return sum / float(SUPERSAMPLES);
+}
+
+#endif
+
+// Dwell can't be filtered, so the four nearest texels are coloured first and blended
+vec3 Upscale(vec2 uv)
+{
+	vec2 pos = uv * vec2(renderSize) - 0.5;
+	ivec2 base = ivec2(floor(pos));
+	vec2 f = pos - vec2(base);
+	ivec2 last = renderSize - 1;
+
+	vec3 a = Shade(texelFetch(dwellTexture, clamp(base, ivec2(0), last), 0).r);
+	vec3 b = Shade(texelFetch(dwellTexture, clamp(base + ivec2(1, 0), ivec2(0), last), 0).r);
+	vec3 c = Shade(texelFetch(dwellTexture, clamp(base + ivec2(0, 1), ivec2(0), last), 0).r);
+	vec3 d = Shade(texelFetch(dwellTexture, clamp(base + ivec2(1, 1), ivec2(0), last), 0).r);
+
+	vec3 value = mix(mix(a, b, f.x), mix(c, d, f.x), f.y);
+
+	// Clamping to the range of the taps keeps the sharpening from ringing
+	vec3 mean = (a + b + c + d) * 0.25;
+	return clamp(value + sharpness * (value - mean), min(min(a, b), min(c, d)), max(max(a, b), max(c, d)));
+}
+
+#endif
+
+void main()
+{
+#ifdef LAYERED
+	vec3 value = Shade(texture(dwellTexture, vec3(fragUV, fragLayer)).r);
+	vec4 color = layerColors[fragLayer];
+#else
+	vec3 value;
+
+	if (all(equal(renderSize, textureSize(dwellTexture, 0))))
+	{
+		value = Shade(texture(dwellTexture, fragUV).r);
+
+#ifdef SUPERSAMPLES
+		uint index = supersampled ? texture(sampleIndex, fragUV).r : 0u;
+		if (index != 0u) value = ShadeSamples(index - 1u);
+#endif
+	}
+	else
+	{
+		value = Upscale(fragUV);
+	}
+#endif
+
+	if (transition == TRANSITION_FADE) value *= transitionProgress;
+
+	fragColor = vec4(value, 1.0) * color;
+}
@@ -0,0 +1,516 @@
+#version 430
+
+// Every fractal is compiled from this kernel, specialised by the defines that
+// KernelConfig injects after the version directive.
+
+#ifndef FORMULA
+#define FORMULA 0
+#endif
+
+// Values must match game::PrecisionTier, tiers above double are emulated on the CPU only
+#define PRECISION_FLOAT 0
+#define PRECISION_DOUBLE 1
+
+#ifndef PRECISION
+#define PRECISION PRECISION_FLOAT
+#endif
+
+#ifndef WORKGROUP_SIZE_X
+#define WORKGROUP_SIZE_X 1
+#endif
+
+#ifndef WORKGROUP_SIZE_Y
+#define WORKGROUP_SIZE_Y 1
+#endif
+
+// Number of horizontally adjacent pixels computed by each invocation
+#ifndef ILP_FACTOR
+#define ILP_FACTOR 1
+#endif
+
+#ifndef BAILOUT
+#define BAILOUT 2.0
+#endif
+
+// Values must match game::DispatchMode
+#define DISPATCH_GRID 0
+#define DISPATCH_TWO_PASS 1
+#define DISPATCH_PERSISTENT 2
+
+#ifndef DISPATCH_MODE
+#define DISPATCH_MODE DISPATCH_GRID
+#endif
+
+// Iterations every pixel gets in the first pass of a two-pass dispatch
+#ifndef FIRST_PASS_ITERATIONS
+#define FIRST_PASS_ITERATIONS 64
+#endif
+
+// Layered kernels render one view per layer of a texture array, picked by the dispatch's z
+#if defined(LAYERED) && DISPATCH_MODE != DISPATCH_GRID
+#error Layered kernels only support grid dispatches
+#endif
+
+#ifndef MAX_LAYERS
+#define MAX_LAYERS 4
+#endif
+
+// Supersampling kernels take SUPERSAMPLES jittered samples in every pixel along the boundaries
+// of an image the kernel already rendered, instead of rendering it
+#if defined(SUPERSAMPLES) && (defined(LAYERED) || DISPATCH_MODE != DISPATCH_GRID)
+#error Supersampling kernels only support non-layered grid dispatches
+#endif
+
+// Pixels covered by one workgroup
+#define GROUP_WIDTH (WORKGROUP_SIZE_X * ILP_FACTOR)
+#define GROUP_PIXELS (GROUP_WIDTH * WORKGROUP_SIZE_Y)
+
+#if PRECISION == PRECISION_FLOAT
+#define REAL float
+#define VEC2 vec2
+#else
+#define REAL double
+#define VEC2 dvec2
+#endif
+
+#include "include/complex.glsl"
+#include "include/formulas.glsl"
+
+layout(local_size_x = WORKGROUP_SIZE_X, local_size_y = WORKGROUP_SIZE_Y) in;
+
+// Escape iteration of every pixel, 0 where it never escaped. Colour is applied when drawing.
+#ifdef LAYERED
+layout(r16ui, binding = 0) uniform uimage2DArray destTex;
+#else
+layout(r16ui, binding = 0) uniform uimage2D destTex;
+#endif
+
+layout(location = 1) uniform int numIterations;
+
+#ifdef LAYERED
+
+// Offset in xy and size in z of every layer's view, w is 0 for layers to leave alone.
+// Views are kept in double by the game, float kernels round them down when they're read.
+layout(std140, binding = 0) uniform LayerViews
+{
+	dvec4 layerViews[MAX_LAYERS];
+};
+
+// Set from the layer's view before anything is iterated
+REAL size;
+VEC2 offset;
+
+#else
+layout(location = 2) uniform REAL size;
+layout(location = 3) uniform VEC2 offset;
+#endif
+
+// Size of destTex, the dispatch is rounded up to whole workgroups
+layout(location = 4) uniform ivec2 imageSize;
+
+// Part of destTex the dispatch covers, the view still spans the whole image
+layout(location = 6) uniform ivec2 regionOrigin;
+layout(location = 7) uniform ivec2 regionSize;
+
+// Offset of every pixel's sample in pixels, frames accumulated over a still view each take another
+layout(location = 11) uniform vec2 jitter;
+
+#if DISPATCH_MODE == DISPATCH_TWO_PASS || defined(SUPERSAMPLES)
+
+// 0 iterates every pixel and queues the unresolved ones, 1 resolves the queue.
+// Supersampling kernels find the boundary in pass 0 and sample it in pass 1.
+layout(location = 5) uniform int kernelPass;
+
+// Most groups an indirect dispatch may launch, the groups of the second pass loop over the
+// items past that
+layout(location = 12) uniform uint maxGroups;
+
+#endif
+
+#ifdef SUPERSAMPLES
+
+// Samples are 16 bits, two to a word
+struct BoundaryPixel
+{
+	ivec2 pixel;
+	uint dwell[SUPERSAMPLES / 2];
+};
+
+// The header doubles as the indirect dispatch arguments of the sampling pass
+layout(std430, binding = 1) buffer Boundary
+{
+	uint boundaryGroups[3];
+	uint boundaryCount;
+	BoundaryPixel boundary[];
+};
+
+// Index + 1 into boundary of every pixel that was supersampled, 0 for the rest
+layout(r32ui, binding = 2, location = 10) uniform writeonly uimage2D sampleIndex;
+
+// Neighbours whose dwell is further apart than this make a boundary, as do escaped pixels
+// next to ones that never escaped
+layout(location = 8) uniform int boundaryThreshold;
+
+// Pixels boundary has room for, the rest keep their single sample
+layout(location = 9) uniform uint boundaryCapacity;
+
+#endif
+
+// A pixel still iterating after the first pass, c is recomputed from its position
+struct WorkItem
+{
+	VEC2 z;
+	VEC2 w;
+	ivec2 pixel;
+};
+
+// For two-pass dispatches the header doubles as the indirect dispatch arguments of the
+// second pass, numGroups[0] is kept at count rounded up to whole groups, up to maxGroups.
+// Persistent dispatches only use count, as the index of the next tile to render.
+layout(std430, binding = 0) buffer WorkQueue
+{
+	uint numGroups[3];
+	uint count;
+	WorkItem items[];
+};
+
+shared uint groupCount;
+shared uint groupBase;
+
+VEC2 WorldPos(vec2 imagePos)
+{
+	vec2 bounds = vec2(imageSize);
+
+	return VEC2(
+		mix(offset.x - size, offset.x + size, REAL(imagePos.x / bounds.x)),
+		mix(offset.y - size, offset.y + size, REAL(imagePos.y / bounds.y))
+	);
+}
+
+VEC2 WorldPos(ivec2 pixel)
+{
+	return WorldPos(vec2(pixel) + jitter);
+}
+
+void StorePixel(ivec2 pixel, int escape)
+{
+#ifdef LAYERED
+	imageStore(destTex, ivec3(pixel, gl_GlobalInvocationID.z), uvec4(min(escape, 65535)));
+#else
+	imageStore(destTex, pixel, uvec4(min(escape, 65535)));
+#endif
+}
+
+// Iterates ILP_FACTOR pixels in lockstep from iteration first up to last. Each has its own
+// escape value, and their chains of dependent multiply-adds are independent, so one pixel's
+// steps hide the latency of another's.
+void Iterate(inout State s[ILP_FACTOR], int first, int last, out int escape[ILP_FACTOR])
+{
+	for (int k = 0; k < ILP_FACTOR; k++)
+	{
+		escape[k] = 0;
+	}
+
+	for (int i = first; i < last; i++)
+	{
+		bool done = true;
+
+		for (int k = 0; k < ILP_FACTOR; k++)
+		{
+			Step(s[k]);
+
+			escape[k] = max(int(dot(s[k].z, s[k].z) > BAILOUT * BAILOUT) * int(escape[k] == 0) * i, escape[k]);
+			done = done && escape[k] != 0;
+		}
+
+		// Escape values never change once set
+		if (done) break;
+	}
+}
+
+#if DISPATCH_MODE == DISPATCH_TWO_PASS
+
+// Picks up the pixels the first pass queued, ILP_FACTOR adjacent items per invocation
+void Resolve()
+{
+	uint start = (gl_WorkGroupID.x * WORKGROUP_SIZE_X * WORKGROUP_SIZE_Y + gl_LocalInvocationIndex) * ILP_FACTOR;
+
+	for (uint first = start; first < count; first += gl_NumWorkGroups.x * GROUP_PIXELS)
+	{
+		State s[ILP_FACTOR];
+		ivec2 pixels[ILP_FACTOR];
+
+		for (int k = 0; k < ILP_FACTOR; k++)
+		{
+			// Lanes past the end of the queue repeat the last item and aren't stored
+			WorkItem item = items[min(first + k, count - 1)];
+
+			pixels[k] = item.pixel;
+			s[k] = Init(WorldPos(item.pixel));
+			s[k].z = item.z;
+			s[k].w = item.w;
+		}
+
+		int escape[ILP_FACTOR];
+		Iterate(s, FIRST_PASS_ITERATIONS, numIterations, escape);
+
+		for (int k = 0; k < ILP_FACTOR && first + k < count; k++)
+		{
+			StorePixel(pixels[k], escape[k]);
+		}
+	}
+}
+
+#endif
+
+// Sets up the lanes of the invocation at the given grid position within the region
+void InitLanes(uvec2 invocation, out State s[ILP_FACTOR], out ivec2 pixels[ILP_FACTOR])
+{
+	for (int k = 0; k < ILP_FACTOR; k++)
+	{
+		// Lanes past the edge repeat the last pixel and aren't stored
+		pixels[k] = regionOrigin + min(ivec2(invocation.x * ILP_FACTOR + k, invocation.y), regionSize - 1);
+		s[k] = Init(WorldPos(pixels[k]));
+	}
+}
+
+bool Inside(uvec2 invocation, int k)
+{
+	return int(invocation.x) * ILP_FACTOR + k < regionSize.x && int(invocation.y) < regionSize.y;
+}
+
+// Renders the pixels of one invocation of a grid covering the whole region
+void RenderGrid(uvec2 invocation)
+{
+	// Invocations past the edge of the region have nothing to do
+	if (int(invocation.y) >= regionSize.y) return;
+
+	State s[ILP_FACTOR];
+	ivec2 pixels[ILP_FACTOR];
+	InitLanes(invocation, s, pixels);
+
+	int escape[ILP_FACTOR];
+	Iterate(s, 0, numIterations, escape);
+
+	for (int k = 0; k < ILP_FACTOR; k++)
+	{
+		if (Inside(invocation, k)) StorePixel(pixels[k], escape[k]);
+	}
+}
+
+#if DISPATCH_MODE == DISPATCH_TWO_PASS
+
+// Iterates every pixel up to FIRST_PASS_ITERATIONS and queues the ones still going
+void FirstPass()
+{
+	// Every invocation has to reach the barriers below, rows past the edge are masked instead
+	int last = min(numIterations, FIRST_PASS_ITERATIONS);
+
+	State s[ILP_FACTOR];
+	ivec2 pixels[ILP_FACTOR];
+	InitLanes(gl_GlobalInvocationID.xy, s, pixels);
+
+	int escape[ILP_FACTOR];
+	Iterate(s, 0, last, escape);
+
+	bool queued[ILP_FACTOR];
+
+	for (int k = 0; k < ILP_FACTOR; k++)
+	{
+		bool inside = Inside(gl_GlobalInvocationID.xy, k);
+
+		// Pixels that haven't escaped by the first pass's cap are left to the second
+		queued[k] = inside && escape[k] == 0 && last < numIterations;
+		if (inside && !queued[k]) StorePixel(pixels[k], escape[k]);
+	}
+
+	// Reserve space for the whole workgroup's queued pixels with a single global atomic
+	if (gl_LocalInvocationIndex == 0) groupCount = 0;
+	memoryBarrierShared();
+	barrier();
+
+	uint slots[ILP_FACTOR];
+
+	for (int k = 0; k < ILP_FACTOR; k++)
+	{
+		if (queued[k]) slots[k] = atomicAdd(groupCount, 1);
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+	if (gl_LocalInvocationIndex == 0 && groupCount > 0)
+	{
+		groupBase = atomicAdd(count, groupCount);
+
+		// The furthest range's end is the queue size, so the largest count is the queue rounded
+		// up to whole groups
+		uint end = groupBase + groupCount;
+		atomicMax(numGroups[0], min((end + GROUP_PIXELS - 1) / GROUP_PIXELS, maxGroups));
+	}
+
+	memoryBarrierShared();
+	barrier();
+
+	for (int k = 0; k < ILP_FACTOR; k++)
+	{
+		if (queued[k]) items[groupBase + slots[k]] = WorkItem(s[k].z, s[k].w, pixels[k]);
+	}
+}
+
+#elif DISPATCH_MODE == DISPATCH_PERSISTENT
+
+// Workgroups stay resident and take tiles of one workgroup's footprint until none of the
+// region is left, so a slow tile only holds up its own workgroup
+void Persistent()
+{
+	uint tilesX = uint(regionSize.x + GROUP_WIDTH - 1) / GROUP_WIDTH;
+	uint tiles = tilesX * (uint(regionSize.y + WORKGROUP_SIZE_Y - 1) / WORKGROUP_SIZE_Y);
+
+	for (;;)
+	{
+		if (gl_LocalInvocationIndex == 0) groupBase = atomicAdd(count, 1);
+		memoryBarrierShared();
+		barrier();
+
+		uint tile = groupBase;
+
+		// Nobody may take the next tile before everyone has read this one
+		barrier();
+
+		if (tile >= tiles) break;
+
+		uvec2 origin = uvec2(tile % tilesX * WORKGROUP_SIZE_X, tile / tilesX * WORKGROUP_SIZE_Y);
+		RenderGrid(origin + gl_LocalInvocationID.xy);
+	}
+}
+
+#endif
+
+#ifdef SUPERSAMPLES
+
+// Queues the pixels whose dwell differs from a neighbour's
+void FindBoundary()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(pixel, imageSize))) return;
+
+	const ivec2 neighbours[4] = ivec2[](ivec2(1, 0), ivec2(-1, 0), ivec2(0, 1), ivec2(0, -1));
+
+	int dwell = int(imageLoad(destTex, pixel).r);
+	bool edge = false;
+
+	for (int i = 0; i < 4; i++)
+	{
+		int other = int(imageLoad(destTex, clamp(pixel + neighbours[i], ivec2(0), imageSize - 1)).r);
+		edge = edge || (other == 0) != (dwell == 0) || abs(other - dwell) > boundaryThreshold;
+	}
+
+	uint index = 0;
+
+	if (edge)
+	{
+		uint slot = atomicAdd(boundaryCount, 1);
+
+		if (slot < boundaryCapacity)
+		{
+			boundary[slot].pixel = pixel;
+			index = slot + 1;
+
+			// Each group's worth of pixels needs another group of the sampling pass, up to the limit
+			if (slot % (WORKGROUP_SIZE_X * WORKGROUP_SIZE_Y) == 0)
+			{
+				atomicMax(boundaryGroups[0], min(slot / (WORKGROUP_SIZE_X * WORKGROUP_SIZE_Y) + 1, maxGroups));
+			}
+		}
+	}
+
+	imageStore(sampleIndex, pixel, uvec4(index));
+}
+
+// Position of sample j, jittered within its cell of a grid over the pixel's footprint. The
+// footprint is centred on the pixel's own sample, so the result doesn't shift.
+vec2 SamplePos(ivec2 pixel, int j)
+{
+	const int grid = int(sqrt(float(SUPERSAMPLES)) + 0.5);
+
+	vec2 seed = vec2(pixel) + vec2(j * 0.618, j * 0.382);
+	vec2 cellOffset = fract(sin(vec2(dot(seed, vec2(12.9898, 78.233)), dot(seed, vec2(39.3468, 11.135)))) * 43758.5453);
+	vec2 cell = vec2(j % grid, j / grid);
+
+	return vec2(pixel) - 0.5 + (cell + cellOffset) / float(grid);
+}
+
+// Takes every sample of one queued pixel, ILP_FACTOR at a time
+void SamplePixel(uint item)
+{
+	ivec2 pixel = boundary[item].pixel;
+
+	uint words[SUPERSAMPLES / 2];
+	for (int i = 0; i < SUPERSAMPLES / 2; i++)
+	{
+		words[i] = 0;
+	}
+
+	for (int first = 0; first < SUPERSAMPLES; first += ILP_FACTOR)
+	{
+		// Lanes past the last sample repeat it and aren't stored
+		State s[ILP_FACTOR];
+		for (int k = 0; k < ILP_FACTOR; k++)
+		{
+			s[k] = Init(WorldPos(SamplePos(pixel, min(first + k, SUPERSAMPLES - 1))));
+		}
+
+		int escape[ILP_FACTOR];
+		Iterate(s, 0, numIterations, escape);
+
+		for (int k = 0; k < ILP_FACTOR && first + k < SUPERSAMPLES; k++)
+		{
+			int j = first + k;
+			words[j / 2] |= uint(min(escape[k], 65535)) << (16 * (j % 2));
+		}
+	}
+
+	for (int i = 0; i < SUPERSAMPLES / 2; i++)
+	{
+		boundary[item].dwell[i] = words[i];
+	}
+}
+
+// Samples the queued pixels, one per invocation at a time
+void SampleBoundary()
+{
+	uint start = gl_WorkGroupID.x * WORKGROUP_SIZE_X * WORKGROUP_SIZE_Y + gl_LocalInvocationIndex;
+	uint queued = min(boundaryCount, boundaryCapacity);
+
+	// Groups past maxGroups aren't launched, so every invocation may take several pixels
+	for (uint item = start; item < queued; item += gl_NumWorkGroups.x * WORKGROUP_SIZE_X * WORKGROUP_SIZE_Y)
+	{
+		SamplePixel(item);
+	}
+}
+
+#endif
+
+void main()
+{
+#ifdef LAYERED
+	dvec4 view = layerViews[gl_GlobalInvocationID.z];
+	if (view.w == 0.0LF) return;
+
+	offset = VEC2(view.xy);
+	size = REAL(view.z);
+#endif
+
+#if defined(SUPERSAMPLES)
+	if (kernelPass == 1) SampleBoundary();
+	else FindBoundary();
+#elif DISPATCH_MODE == DISPATCH_TWO_PASS
+	if (kernelPass == 1) Resolve();
+	else FirstPass();
+#elif DISPATCH_MODE == DISPATCH_PERSISTENT
+	Persistent();
+#else
+	RenderGrid(gl_GlobalInvocationID.xy);
+#endif
+}
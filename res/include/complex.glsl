@@ -0,0 +1,21 @@
+// Complex arithmetic on VEC2, shared by every fractal kernel
+
+VEC2 ComplexBar(VEC2 c)
+{
+	return VEC2(c.x, -c.y);
+}
+
+VEC2 ComplexSquare(VEC2 c)
+{
+	return VEC2(c.x * c.x - c.y * c.y, 2.0 * c.x * c.y);
+}
+
+VEC2 ComplexMul(VEC2 r, VEC2 l)
+{
+	return VEC2(r.x * l.x - r.y * l.y, r.x * l.y + r.y * l.x);
+}
+
+VEC2 ComplexAdd(VEC2 r, VEC2 l)
+{
+	return VEC2(r.x + l.x, r.y + l.y);
+}
@@ -0,0 +1,112 @@
+// Per-fractal iteration formulas, selected by FORMULA.
+// Values must match game::Formula.
+
+#define FORMULA_MANDELBROT 0
+#define FORMULA_TRICORN 1
+#define FORMULA_BURNING_SHIP 2
+#define FORMULA_JULIA0 3
+#define FORMULA_JULIA1 4
+#define FORMULA_JULIA2 5
+#define FORMULA_MULTIBROT3 6
+#define FORMULA_MULTIBROT8 11
+#define FORMULA_MULTICORN3 12
+#define FORMULA_MULTICORN8 17
+
+#if FORMULA >= FORMULA_MULTIBROT3 && FORMULA <= FORMULA_MULTIBROT8
+#define EXPONENT (FORMULA - FORMULA_MULTIBROT3 + 3)
+#elif FORMULA >= FORMULA_MULTICORN3 && FORMULA <= FORMULA_MULTICORN8
+#define EXPONENT (FORMULA - FORMULA_MULTICORN3 + 3)
+#define CONJUGATE_POWER
+#endif
+
+// z is the iterated value, w is extra state for formulas that need a second term
+struct State
+{
+	VEC2 z;
+	VEC2 w;
+	VEC2 c;
+};
+
+#ifdef EXPONENT
+
+// Index of the highest set bit of EXPONENT
+#if EXPONENT >= 8
+#define EXPONENT_TOP_BIT 3
+#elif EXPONENT >= 4
+#define EXPONENT_TOP_BIT 2
+#else
+#define EXPONENT_TOP_BIT 1
+#endif
+
+// z^EXPONENT by repeated squaring. The exponent is a compile-time constant,
+// so the loop and the branch fold away into a fixed chain of multiplies.
+VEC2 ComplexPow(VEC2 z)
+{
+	VEC2 result = z;
+
+	for (int bit = EXPONENT_TOP_BIT - 1; bit >= 0; bit--)
+	{
+		result = ComplexSquare(result);
+
+		if (((EXPONENT >> bit) & 1) != 0)
+		{
+			result = ComplexMul(result, z);
+		}
+	}
+
+	return result;
+}
+
+#endif
+
+#if FORMULA == FORMULA_MANDELBROT || FORMULA == FORMULA_TRICORN || FORMULA == FORMULA_BURNING_SHIP || defined(EXPONENT)
+
+State Init(VEC2 pos)
+{
+	return State(VEC2(0.0, 0.0), VEC2(0.0, 0.0), pos);
+}
+
+#elif FORMULA == FORMULA_JULIA0 || FORMULA == FORMULA_JULIA1
+
+#if FORMULA == FORMULA_JULIA0
+#define JULIA_C VEC2(-0.835, 0.2321)
+#else
+#define JULIA_C VEC2(0.285, 0.01)
+#endif
+
+State Init(VEC2 pos)
+{
+	return State(pos, VEC2(0.0, 0.0), JULIA_C);
+}
+
+#elif FORMULA == FORMULA_JULIA2
+
+#define JULIA2_P -0.47
+
+State Init(VEC2 pos)
+{
+	return State(pos.yx, VEC2(0.0, 0.0), VEC2(0.544992, 0.0));
+}
+
+#else
+#error Unknown FORMULA
+#endif
+
+void Step(inout State s)
+{
+#if defined(CONJUGATE_POWER)
+	s.z = ComplexAdd(ComplexPow(ComplexBar(s.z)), s.c);
+#elif defined(EXPONENT)
+	s.z = ComplexAdd(ComplexPow(s.z), s.c);
+#elif FORMULA == FORMULA_TRICORN
+	s.z = ComplexAdd(ComplexSquare(ComplexBar(s.z)), s.c);
+#elif FORMULA == FORMULA_BURNING_SHIP
+	s.z = ComplexAdd(ComplexSquare(abs(s.z)), s.c);
+#elif FORMULA == FORMULA_JULIA2
+	VEC2 tmp = s.z;
+	s.z = ComplexSquare(s.z) + s.c + (JULIA2_P * s.w);
+	s.w = tmp;
+#else
+	s.z = ComplexAdd(ComplexSquare(s.z), s.c);
+#endif
+}
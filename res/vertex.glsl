@@ -7,9 +7,33 @@ layout(location = 1) in vec2 inUV;
 
 layout(location = 0) out vec2 fragUV;
 
+#ifdef LAYERED
+// Instance i draws layer i, moved this far down the screen from the first
+layout(location = 9) uniform vec2 layerStride;
+// Bit i is set for layers to draw, the others are culled
+layout(location = 14) uniform int layerMask;
+
+layout(location = 1) flat out int fragLayer;
+#endif
+
 void main()
 {
+#ifdef LAYERED
+	fragLayer = gl_InstanceID;
+
+	if ((layerMask & (1 << gl_InstanceID)) == 0)
+	{
+		// Outside the clip volume, so the instance produces no fragments
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		fragUV = inUV;
+		return;
+	}
+
+	vec3 t = vec3(inPos + layerStride * gl_InstanceID, 1.0) * proj;
+#else
 	vec3 t = vec3(inPos, 1.0) * proj;
+#endif
+
 	gl_Position = vec4(t, 1.0);
 	fragUV = inUV;
 }
@@ -0,0 +1,231 @@
+#include "CpuRenderer.hpp"
+
+#include "Kernel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace game;
+
+namespace
+{
+	constexpr int SIMD_LANES_FLOAT = 8;
+	constexpr int SIMD_LANES_DOUBLE = 4;
+	constexpr int SIMD_LANES_DOUBLE_DOUBLE = 2;
+	constexpr int SIMD_LANES_PERTURBATION = 4;
+
+	// mix(offset - size, offset + size, pixel / count), as in the GPU kernel
+	template <class Real>
+	Real PixelCoordinate(double offset, double size, std::uint32_t pixel, std::uint32_t count)
+	{
+		Real t = Real(static_cast<double>(pixel) / static_cast<double>(count));
+		return (Real(offset) - Real(size)) + t * (Real(size) + Real(size));
+	}
+
+	template <class F>
+	struct RowContext
+	{
+		const CpuRenderParams& params;
+		const CpuView& view;
+		const ReferenceOrbit<F>* reference;
+	};
+
+	// Renders pixels [begin, end) of row y
+	template <class F, class Real, int Lanes>
+	std::uint64_t RenderRowDirect(const RowContext<F>& ctx, std::uint32_t y, std::uint32_t begin, std::uint32_t end, std::int32_t* row)
+	{
+		const CpuView& view = ctx.view;
+		const Real im = PixelCoordinate<Real>(view.offsetY, view.size, y, view.height);
+		std::uint64_t iterations = 0;
+
+		for (std::uint32_t x = begin; x < end; x += Lanes)
+		{
+			Complex<Real> pos[Lanes];
+			std::int32_t escape[Lanes];
+
+			// Lanes past the end of the range repeat the last pixel and are discarded
+			for (int l = 0; l < Lanes; l++)
+			{
+				std::uint32_t px = std::min(x + l, end - 1);
+				pos[l] = { PixelCoordinate<Real>(view.offsetX, view.size, px, view.width), im };
+			}
+
+			iterations += Iterate<F, Real, Lanes>(pos, ctx.params.formulaParams, ctx.params.iterations, ctx.params.bailout, escape);
+
+			for (int l = 0; l < Lanes && x + l < end; l++)
+			{
+				row[x + l] = escape[l];
+			}
+		}
+
+		return iterations;
+	}
+
+	template <class F, int Lanes>
+	std::uint64_t RenderRowPerturbed(const RowContext<F>& ctx, std::uint32_t y, std::uint32_t begin, std::uint32_t end, std::int32_t* row, std::uint64_t& fallbackPixels)
+	{
+		const CpuView& view = ctx.view;
+		const CpuRenderParams& params = ctx.params;
+		const DoubleDouble im = PixelCoordinate<DoubleDouble>(view.offsetY, view.size, y, view.height);
+		std::uint64_t iterations = 0;
+
+		for (std::uint32_t x = begin; x < end; x += Lanes)
+		{
+			Complex<DoubleDouble> pos[Lanes];
+			std::int32_t escape[Lanes];
+			bool needsFallback[Lanes];
+
+			for (int l = 0; l < Lanes; l++)
+			{
+				std::uint32_t px = std::min(x + l, end - 1);
+				pos[l] = { PixelCoordinate<DoubleDouble>(view.offsetX, view.size, px, view.width), im };
+			}
+
+			iterations += Perturb<F, Lanes>(*ctx.reference, pos, params.formulaParams, params.iterations, params.bailout, escape, needsFallback);
+
+			for (int l = 0; l < Lanes && x + l < end; l++)
+			{
+				if (needsFallback[l])
+				{
+					Complex<DoubleDouble> single[1] = { pos[l] };
+					std::int32_t singleEscape[1];
+					iterations += Iterate<F, DoubleDouble, 1>(single, params.formulaParams, params.iterations, params.bailout, singleEscape);
+					escape[l] = singleEscape[0];
+					fallbackPixels++;
+				}
+
+				row[x + l] = escape[l];
+			}
+		}
+
+		return iterations;
+	}
+
+	template <class F>
+	std::uint64_t RenderRow(const RowContext<F>& ctx, std::uint32_t y, std::uint32_t begin, std::uint32_t end, std::int32_t* row, std::uint64_t& fallbackPixels)
+	{
+		bool simd = ctx.params.backend == CpuBackend::Simd;
+
+		switch (ctx.params.precision)
+		{
+			case PrecisionTier::Float:
+				return simd ?
+					RenderRowDirect<F, float, SIMD_LANES_FLOAT>(ctx, y, begin, end, row) :
+					RenderRowDirect<F, float, 1>(ctx, y, begin, end, row);
+			case PrecisionTier::DoubleDouble:
+				return simd ?
+					RenderRowDirect<F, DoubleDouble, SIMD_LANES_DOUBLE_DOUBLE>(ctx, y, begin, end, row) :
+					RenderRowDirect<F, DoubleDouble, 1>(ctx, y, begin, end, row);
+			case PrecisionTier::Perturbation:
+				return simd ?
+					RenderRowPerturbed<F, SIMD_LANES_PERTURBATION>(ctx, y, begin, end, row, fallbackPixels) :
+					RenderRowPerturbed<F, 1>(ctx, y, begin, end, row, fallbackPixels);
+			default:
+				return simd ?
+					RenderRowDirect<F, double, SIMD_LANES_DOUBLE>(ctx, y, begin, end, row) :
+					RenderRowDirect<F, double, 1>(ctx, y, begin, end, row);
+		}
+	}
+
+	template <class F>
+	CpuRenderStats RenderFormula(const CpuRenderParams& params, const CpuView& view, std::vector<std::int32_t>& dwell)
+	{
+		std::unique_ptr<ReferenceOrbit<F>> reference;
+
+		if (params.precision == PrecisionTier::Perturbation)
+		{
+			Complex<DoubleDouble> centre { DoubleDouble(view.offsetX), DoubleDouble(view.offsetY) };
+			reference.reset(new ReferenceOrbit<F>(centre, params.formulaParams, params.iterations, params.bailout));
+		}
+
+		RowContext<F> ctx { params, view, reference.get() };
+
+		// Pixel y mirrors pixel height - y around the view centre, so only rows up to the
+		// middle are iterated and the rest copied. Row 0 and, for point symmetry, column 0
+		// have no mirror inside the view and are always computed.
+		Symmetry symmetry = Symmetry::None;
+
+		if (params.exploitSymmetry)
+		{
+			if (F::symmetry == Symmetry::Conjugate && view.offsetY == 0.0) symmetry = Symmetry::Conjugate;
+			if (F::symmetry == Symmetry::Point && view.offsetX == 0.0 && view.offsetY == 0.0) symmetry = Symmetry::Point;
+		}
+
+		const std::uint32_t computedRows = symmetry == Symmetry::None ? view.height : view.height / 2 + 1;
+
+		std::atomic<std::uint32_t> nextRow(0);
+		std::atomic<std::uint64_t> totalIterations(0);
+		std::atomic<std::uint64_t> totalFallback(0);
+
+		auto worker = [&]()
+		{
+			std::uint64_t iterations = 0;
+			std::uint64_t fallback = 0;
+
+			for (std::uint32_t y = nextRow++; y < view.height; y = nextRow++)
+			{
+				std::int32_t* row = dwell.data() + static_cast<std::size_t>(y) * view.width;
+
+				if (y < computedRows)
+				{
+					iterations += RenderRow<F>(ctx, y, 0, view.width, row, fallback);
+				}
+				else if (symmetry == Symmetry::Point)
+				{
+					iterations += RenderRow<F>(ctx, y, 0, 1, row, fallback);
+				}
+			}
+
+			totalIterations += iterations;
+			totalFallback += fallback;
+		};
+
+		std::uint32_t numThreads = params.threads != 0 ? params.threads : std::max(1u, std::thread::hardware_concurrency());
+		numThreads = std::min(numThreads, view.height);
+
+		std::vector<std::thread> threads;
+		for (std::uint32_t i = 1; i < numThreads; i++)
+		{
+			threads.emplace_back(worker);
+		}
+
+		worker();
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		for (std::uint32_t y = computedRows; y < view.height; y++)
+		{
+			std::int32_t* row = dwell.data() + static_cast<std::size_t>(y) * view.width;
+			const std::int32_t* mirror = dwell.data() + static_cast<std::size_t>(view.height - y) * view.width;
+
+			if (symmetry == Symmetry::Conjugate)
+			{
+				std::copy(mirror, mirror + view.width, row);
+			}
+			else
+			{
+				for (std::uint32_t x = 1; x < view.width; x++)
+				{
+					row[x] = mirror[view.width - x];
+				}
+			}
+		}
+
+		return { totalIterations.load(), totalFallback.load() };
+	}
+}
+
+CpuRenderStats game::RenderDwell(const CpuRenderParams& params, const CpuView& view, std::vector<std::int32_t>& dwell)
+{
+	dwell.resize(static_cast<std::size_t>(view.width) * view.height);
+	if (view.width == 0 || view.height == 0) return { 0, 0 };
+
+	return DispatchFormula(params.formula, [&](auto formula)
+	{
+		return RenderFormula<decltype(formula)>(params, view, dwell);
+	});
+}
@@ -0,0 +1,1055 @@
+#include "CpuRenderer.hpp"
+#include "LevelPack.hpp"
+#include "Shader.hpp"
+
+#include "VLFW/VLFW.hpp"
+#include "glad/glad.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace game;
+using namespace vlfw;
+
+// Measures kernel throughput for every formula, precision tier and backend over the
+// targets of a level pack, and writes the results as JSON:
+//
+//   fractal_bench [--pack <levels.pack>] [--out <results.json>] [--width <pixels>]
+//                 [--height <pixels>] [--warmup <runs>] [--repeat <runs>] [--threads <count>]
+//                 [--formula <name>]... [--precision <name>]... [--backend <name>]...
+//                 [--no-gl] [--no-symmetry] [--per-level] [--dive] [--zoom-step <factor>]
+//                 [--workgroup <x>x<y>]... [--ilp <factor>]... [--dispatch <mode>]...
+//                 [--first-pass <iterations>] [--persistent-groups <count>] [--verify]
+//
+// GL results are measured for every combination of the given workgroup sizes, ILP
+// factors and dispatch modes, to find the best kernel variant for a device. --per-level
+// measures every level on its own with its own formula and precision instead.
+//
+// Every level contributes its four targets and its starting view. One run renders all of
+// them, warmup runs are discarded and the rates are taken from the median run.
+//
+// With --dive, every target of every level is instead zoomed into from the starting view,
+// one scroll step per frame as a player would, and frame time percentiles are reported per
+// dive. Dives render with the level's own formula and precision, on GL unless a single
+// --backend is given or no context can be created, in which case the CPU engine is used.
+//
+// With --verify, nothing is timed. Every view is rendered on GL by a grid kernel with one
+// pixel per workgroup, and every kernel variant must give the same dwell whole, in sliced
+// regions and, for grid variants, as layers of a layered dispatch. Without --workgroup,
+// --ilp or --dispatch every size, factor and mode is checked. Exits with 1 on any difference.
+
+namespace
+{
+	// The game starts every level at this zoom, centred on the origin
+	constexpr double DEFAULT_ZOOM = 2.0;
+
+	// --verify fills outputs with this first, so pixels a dispatch missed show up as differences
+	constexpr std::uint16_t UNWRITTEN = 0xFFFF;
+
+	// Rows of the region dispatches --verify renders views in, as the game prefetches them
+	constexpr std::uint32_t SLICE_ROWS = 13;
+
+	enum class Backend : std::uint32_t
+	{
+		Scalar = 0,
+		Simd,
+		GL,
+		Count
+	};
+
+	const char* const BACKEND_NAMES[] =
+	{
+		"scalar",
+		"simd",
+		"gl",
+	};
+
+	static_assert(sizeof(BACKEND_NAMES) / sizeof(BACKEND_NAMES[0]) == static_cast<std::size_t>(Backend::Count), "Backend name table out of date");
+
+	struct Viewport
+	{
+		double offsetX;
+		double offsetY;
+		double size;
+		std::int32_t iterations;
+	};
+
+	struct Options
+	{
+		std::string pack = "res/levels.pack";
+		std::string out = "bench.json";
+		std::uint32_t width = 256;
+		std::uint32_t height = 256;
+		std::uint32_t warmup = 1;
+		std::uint32_t repeat = 5;
+		std::uint32_t threads = 0;
+		std::vector<Formula> formulas;
+		std::vector<PrecisionTier> precisions;
+		std::vector<Backend> backends;
+		bool gl = true;
+		bool symmetry = true;
+		bool perLevel = false;
+		bool dive = false;
+		bool verify = false;
+		// Zoom change per frame during a dive, one scroll step in the game
+		double zoomStep = 0.9;
+		std::vector<std::string> workgroups;
+		std::vector<UInt> ilpFactors;
+		std::vector<DispatchMode> dispatchModes;
+		UInt firstPassIterations = 64;
+		UInt persistentGroups = 256;
+		// Every combination of the above, formula and precision are overridden per run
+		std::vector<KernelConfig> kernels;
+	};
+
+	// Viewports rendered together as one result
+	struct Workload
+	{
+		// -1 when the workload covers the whole pack
+		std::int32_t level;
+		Formula formula;
+		PrecisionTier precision;
+		std::vector<Viewport> viewports;
+	};
+
+	struct Result
+	{
+		std::int32_t level;
+		Formula formula;
+		PrecisionTier precision;
+		Backend backend;
+		KernelConfig kernel;
+		std::uint64_t pixels;
+		std::uint64_t iterations;
+		std::vector<double> seconds;
+	};
+
+	struct DiveResult
+	{
+		std::uint32_t level;
+		std::uint32_t target;
+		Formula formula;
+		PrecisionTier precision;
+		Backend backend;
+		double firstFrameSeconds;
+		std::vector<double> frameSeconds;
+		std::vector<double> cpuSeconds;
+		std::vector<double> gpuSeconds;
+	};
+
+	Backend ParseBackend(const std::string& name)
+	{
+		for (std::size_t i = 0; i < static_cast<std::size_t>(Backend::Count); i++)
+		{
+			if (name == BACKEND_NAMES[i]) return static_cast<Backend>(i);
+		}
+
+		throw std::runtime_error("Unknown backend: " + name);
+	}
+
+	Options ParseOptions(int argc, char** argv)
+	{
+		Options options;
+
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+
+			auto value = [&]() -> std::string
+			{
+				if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+				return argv[++i];
+			};
+
+			auto number = [&]() -> std::uint32_t
+			{
+				return static_cast<std::uint32_t>(std::stoul(value()));
+			};
+
+			if (arg == "--pack") options.pack = value();
+			else if (arg == "--out") options.out = value();
+			else if (arg == "--width") options.width = number();
+			else if (arg == "--height") options.height = number();
+			else if (arg == "--warmup") options.warmup = number();
+			else if (arg == "--repeat") options.repeat = std::max(1u, number());
+			else if (arg == "--threads") options.threads = number();
+			else if (arg == "--formula") options.formulas.push_back(ParseFormula(value()));
+			else if (arg == "--precision") options.precisions.push_back(ParsePrecisionTier(value()));
+			else if (arg == "--backend") options.backends.push_back(ParseBackend(value()));
+			else if (arg == "--no-gl") options.gl = false;
+			else if (arg == "--no-symmetry") options.symmetry = false;
+			else if (arg == "--per-level") options.perLevel = true;
+			else if (arg == "--dive") options.dive = true;
+			else if (arg == "--verify") options.verify = true;
+			else if (arg == "--zoom-step") options.zoomStep = std::stod(value());
+			else if (arg == "--workgroup") options.workgroups.push_back(value());
+			else if (arg == "--ilp") options.ilpFactors.push_back(std::max(1u, number()));
+			else if (arg == "--dispatch") options.dispatchModes.push_back(ParseDispatchMode(value()));
+			else if (arg == "--first-pass") options.firstPassIterations = std::max(1u, number());
+			else if (arg == "--persistent-groups") options.persistentGroups = std::max(1u, number());
+			else throw std::runtime_error("Unknown option: " + arg);
+		}
+
+		if (options.width == 0 || options.height == 0)
+		{
+			throw std::runtime_error("Viewport size must not be zero");
+		}
+
+		if (options.zoomStep <= 0.0 || options.zoomStep >= 1.0)
+		{
+			throw std::runtime_error("Zoom step must be between 0 and 1");
+		}
+
+		// Nothing selected means everything
+		if (options.formulas.empty())
+		{
+			for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(Formula::Count); i++)
+			{
+				options.formulas.push_back(static_cast<Formula>(i));
+			}
+		}
+
+		if (options.precisions.empty())
+		{
+			for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(PrecisionTier::Count); i++)
+			{
+				options.precisions.push_back(static_cast<PrecisionTier>(i));
+			}
+		}
+
+		if (options.backends.empty())
+		{
+			for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(Backend::Count); i++)
+			{
+				options.backends.push_back(static_cast<Backend>(i));
+			}
+		}
+
+		// Verification covers every variant unless asked for fewer
+		if (options.workgroups.empty())
+		{
+			options.workgroups = options.verify ? std::vector<std::string> { "8x8", "16x16", "32x8" } : std::vector<std::string> { "8x8" };
+		}
+
+		if (options.ilpFactors.empty())
+		{
+			options.ilpFactors = options.verify ? std::vector<UInt> { 1, 2, 4 } : std::vector<UInt> { 1 };
+		}
+
+		if (options.dispatchModes.empty())
+		{
+			options.dispatchModes.push_back(DispatchMode::Grid);
+
+			for (UInt i = 1; options.verify && i < static_cast<UInt>(DispatchMode::Count); i++)
+			{
+				options.dispatchModes.push_back(static_cast<DispatchMode>(i));
+			}
+		}
+
+		for (const std::string& workgroup : options.workgroups)
+		for (UInt ilpFactor : options.ilpFactors)
+		for (DispatchMode dispatchMode : options.dispatchModes)
+		{
+			KernelConfig kernel;
+			kernel.SetWorkgroupSize(workgroup);
+			kernel.ilpFactor = ilpFactor;
+			kernel.dispatchMode = dispatchMode;
+			kernel.firstPassIterations = options.firstPassIterations;
+			kernel.persistentGroups = options.persistentGroups;
+			options.kernels.push_back(kernel);
+		}
+
+		return options;
+	}
+
+	std::vector<Workload> LoadWorkloads(const Options& options)
+	{
+		LevelPack pack;
+		if (!pack.Open(options.pack) || pack.GetLevelCount() == 0)
+		{
+			throw std::runtime_error("Failed to load level pack: " + options.pack);
+		}
+
+		std::vector<Workload> levels;
+
+		for (std::uint32_t i = 0; i < pack.GetLevelCount(); i++)
+		{
+			const LevelRecord& record = pack.GetLevel(i);
+			std::int32_t iterations = static_cast<std::int32_t>(record.iterationBudget);
+
+			Workload level { static_cast<std::int32_t>(i), record.formula, record.precision, {} };
+			level.viewports.push_back({ 0.0, 0.0, DEFAULT_ZOOM, iterations });
+
+			for (std::uint32_t t = 0; t < 4; t++)
+			{
+				level.viewports.push_back({ record.offsets[t][0], record.offsets[t][1], record.zooms[t], iterations });
+			}
+
+			levels.push_back(level);
+		}
+
+		if (options.perLevel) return levels;
+
+		// Every formula and precision over the views of the whole pack
+		std::vector<Viewport> viewports;
+
+		for (const Workload& level : levels)
+		{
+			viewports.insert(viewports.end(), level.viewports.begin(), level.viewports.end());
+		}
+
+		std::vector<Workload> workloads;
+
+		for (Formula formula : options.formulas)
+		for (PrecisionTier precision : options.precisions)
+		{
+			workloads.push_back({ -1, formula, precision, viewports });
+		}
+
+		return workloads;
+	}
+
+	// Runs the fractal kernel in a hidden window's context
+	class GlBench
+	{
+		VLFWMainArgs vlfwArgs;
+		VLFWMain vlfw;
+		Window* window;
+		// Queries the driver, so it's created once the context is current
+		std::unique_ptr<ShaderCache> shaderCache;
+		UInt outputTexture;
+		UInt layerTexture;
+		UInt layerViewBuffer;
+		UInt timerQuery;
+		KernelConfig kernel;
+		WorkQueue workQueue;
+		std::uint32_t width;
+		std::uint32_t height;
+
+		public:
+		GlBench(std::uint32_t _width, std::uint32_t _height) :
+			vlfwArgs(),
+			vlfw(vlfwArgs),
+			window(nullptr),
+			shaderCache(),
+			outputTexture(0),
+			layerTexture(0),
+			layerViewBuffer(0),
+			timerQuery(0),
+			width(_width),
+			height(_height)
+		{
+			WindowHints hints {};
+			hints.title = u8"Fractal Finder Benchmark";
+			hints.contextAPI = ContextAPI::OpenGL;
+			hints.contextVersionMajor = 4;
+			hints.contextVersionMinor = 3;
+			hints.visible = false;
+			hints.size = IVector2(64, 64);
+			window = Component<Window>::Create(0, hints);
+			window->MakeContextCurrent();
+
+			if (!gladLoadGLLoader((GLADloadproc)window->GetOpenGLProcessLoader()))
+			{
+				throw std::runtime_error("Failed to initialize glad");
+			}
+
+			shaderCache.reset(new ShaderCache("shadercache"));
+
+			Content<GLSLFile>::SetContentPrefix("res/");
+			LoadShader("fractal.glsl", "fractal");
+
+			glGenTextures(1, &outputTexture);
+			glBindTexture(GL_TEXTURE_2D, outputTexture);
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16UI, width, height);
+			glBindImageTexture(0, outputTexture, 0, false, 0, GL_WRITE_ONLY, GL_R16UI);
+
+			// Layered kernels write to unit 1, so unit 0 keeps the output of every other kernel
+			glGenTextures(1, &layerTexture);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, layerTexture);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R16UI, width, height, MAX_KERNEL_LAYERS);
+			glBindImageTexture(1, layerTexture, 0, true, 0, GL_WRITE_ONLY, GL_R16UI);
+
+			glGenBuffers(1, &layerViewBuffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, layerViewBuffer);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(double) * 4 * MAX_KERNEL_LAYERS, nullptr, GL_DYNAMIC_DRAW);
+			glBindBufferBase(GL_UNIFORM_BUFFER, 0, layerViewBuffer);
+
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+			glGenQueries(1, &timerQuery);
+		}
+
+		~GlBench()
+		{
+			glDeleteQueries(1, &timerQuery);
+			glDeleteBuffers(1, &layerViewBuffer);
+			glDeleteTextures(1, &layerTexture);
+			glDeleteTextures(1, &outputTexture);
+		}
+
+		std::string GetRenderer() const
+		{
+			return reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+		}
+
+		// The GPU kernels only have float and double variants
+		static bool Supports(PrecisionTier precision)
+		{
+			return precision == PrecisionTier::Float || precision == PrecisionTier::Double;
+		}
+
+		// Programs are dispatched with the parameters of the last one created
+		UInt CreateProgram(const KernelConfig& config, Formula formula, PrecisionTier precision)
+		{
+			kernel = config;
+			kernel.formula = formula;
+			kernel.precision = precision;
+			return CreateComputeProgram(*shaderCache, "fractal", kernel.Defines());
+		}
+
+		// Returns the iterations budgeted, every pixel running to the limit. The kernel stops
+		// early once all pixels of an invocation have escaped, so this is an upper bound.
+		std::uint64_t Render(UInt program, PrecisionTier precision, const std::vector<Viewport>& viewports)
+		{
+			glUseProgram(program);
+			std::uint64_t iterations = 0;
+
+			for (const Viewport& view : viewports)
+			{
+				iterations += Dispatch(precision, view);
+			}
+
+			glFinish();
+			return iterations;
+		}
+
+		// Renders one frame and waits for it, returning the GPU time spent in the dispatch
+		double RenderTimed(UInt program, PrecisionTier precision, const Viewport& view)
+		{
+			glUseProgram(program);
+
+			glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+			Dispatch(precision, view);
+			glEndQuery(GL_TIME_ELAPSED);
+
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &nanoseconds);
+			return static_cast<double>(nanoseconds) * 1e-9;
+		}
+
+		// Renders one view over an output filled with UNWRITTEN and reads back its dwell.
+		// With sliceRows, the view is rendered in region dispatches of that many rows, each
+		// split at a column that isn't a multiple of any workgroup's width.
+		std::vector<std::uint16_t> Capture(UInt program, PrecisionTier precision, const Viewport& view, std::uint32_t sliceRows = 0)
+		{
+			std::vector<std::uint16_t> dwell(static_cast<std::size_t>(width) * height, UNWRITTEN);
+			glBindTexture(GL_TEXTURE_2D, outputTexture);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, dwell.data());
+
+			glUseProgram(program);
+
+			if (sliceRows == 0)
+			{
+				Dispatch(precision, view);
+			}
+			else
+			{
+				SetView(precision, view);
+				std::uint32_t split = std::min(width, width / 3 | 1);
+
+				for (std::uint32_t y = 0; y < height; y += sliceRows)
+				{
+					std::uint32_t rows = std::min(sliceRows, height - y);
+					DispatchRegion(kernel, workQueue, width, height, 0, y, split, rows);
+					if (split < width) DispatchRegion(kernel, workQueue, width, height, split, y, width - split, rows);
+				}
+			}
+
+			glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, dwell.data());
+			return dwell;
+		}
+
+		// Renders the view of every layer with a layered program in one dispatch and reads back
+		// every layer. Layers without a view are flagged off and must stay UNWRITTEN. The views
+		// share one iteration count.
+		std::vector<std::uint16_t> CaptureLayers(UInt program, const Viewport* const (&views)[MAX_KERNEL_LAYERS])
+		{
+			std::vector<std::uint16_t> dwell(static_cast<std::size_t>(width) * height * MAX_KERNEL_LAYERS, UNWRITTEN);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, layerTexture);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, MAX_KERNEL_LAYERS, GL_RED_INTEGER, GL_UNSIGNED_SHORT, dwell.data());
+
+			double layerViews[MAX_KERNEL_LAYERS][4] = {};
+			std::int32_t iterations = 0;
+
+			for (std::size_t i = 0; i < MAX_KERNEL_LAYERS; i++)
+			{
+				if (views[i] == nullptr) continue;
+
+				layerViews[i][0] = views[i]->offsetX;
+				layerViews[i][1] = views[i]->offsetY;
+				layerViews[i][2] = views[i]->size;
+				layerViews[i][3] = 1.0;
+				iterations = views[i]->iterations;
+			}
+
+			glBindBuffer(GL_UNIFORM_BUFFER, layerViewBuffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(layerViews), layerViews);
+
+			glUseProgram(program);
+			glUniform1i(0, 1); // destTex is the array in unit 1
+			glUniform1i(1, iterations);
+			DispatchKernel(kernel, workQueue, width, height, MAX_KERNEL_LAYERS);
+
+			glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, dwell.data());
+			return dwell;
+		}
+
+		private:
+		void SetView(PrecisionTier precision, const Viewport& view)
+		{
+			glUniform1i(1, view.iterations);
+
+			if (precision == PrecisionTier::Double)
+			{
+				glUniform1d(2, view.size);
+				glUniform2d(3, view.offsetX, view.offsetY);
+			}
+			else
+			{
+				glUniform1f(2, static_cast<float>(view.size));
+				glUniform2f(3, static_cast<float>(view.offsetX), static_cast<float>(view.offsetY));
+			}
+		}
+
+		std::uint64_t Dispatch(PrecisionTier precision, const Viewport& view)
+		{
+			SetView(precision, view);
+			DispatchKernel(kernel, workQueue, width, height);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+			return static_cast<std::uint64_t>(width) * height * static_cast<std::uint64_t>(view.iterations);
+		}
+	};
+
+	std::uint64_t RenderCpu(const Options& options, Formula formula, PrecisionTier precision, Backend backend, const std::vector<Viewport>& viewports)
+	{
+		CpuRenderParams params;
+		params.formula = formula;
+		params.precision = precision;
+		params.backend = backend == Backend::Scalar ? CpuBackend::Scalar : CpuBackend::Simd;
+		params.threads = options.threads;
+		params.exploitSymmetry = options.symmetry;
+
+		std::vector<std::int32_t> dwell;
+		std::uint64_t iterations = 0;
+
+		for (const Viewport& view : viewports)
+		{
+			params.iterations = view.iterations;
+			CpuView cpuView { view.offsetX, view.offsetY, view.size, options.width, options.height };
+			iterations += RenderDwell(params, cpuView, dwell).iterations;
+		}
+
+		return iterations;
+	}
+
+	// Quoted and escaped, pack paths and renderer strings may hold anything
+	std::string JsonString(const std::string& value)
+	{
+		std::ostringstream out;
+		out << '"';
+
+		for (unsigned char c : value)
+		{
+			if (c == '"' || c == '\\') out << '\\' << c;
+			else if (c < 0x20) out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+			else out << c;
+		}
+
+		out << '"';
+		return out.str();
+	}
+
+	double Median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		std::size_t middle = values.size() / 2;
+		return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+	}
+
+	void WriteKernelReport(const std::string& path, const Options& options, const std::string& renderer, const std::vector<Result>& results)
+	{
+		std::ofstream file(path);
+		file << std::setprecision(9);
+
+		file << "{\n";
+		file << "\t\"pack\": " << JsonString(options.pack) << ",\n";
+		file << "\t\"width\": " << options.width << ",\n";
+		file << "\t\"height\": " << options.height << ",\n";
+		file << "\t\"perLevel\": " << (options.perLevel ? "true" : "false") << ",\n";
+		file << "\t\"warmup\": " << options.warmup << ",\n";
+		file << "\t\"repeat\": " << options.repeat << ",\n";
+		file << "\t\"threads\": " << options.threads << ",\n";
+		file << "\t\"symmetry\": " << (options.symmetry ? "true" : "false") << ",\n";
+		file << "\t\"glRenderer\": " << JsonString(renderer) << ",\n";
+		file << "\t\"results\": [\n";
+
+		for (std::size_t i = 0; i < results.size(); i++)
+		{
+			const Result& result = results[i];
+			double median = Median(result.seconds);
+
+			file << "\t\t{ ";
+			if (result.level >= 0) file << "\"level\": " << result.level << ", ";
+			file << "\"formula\": \"" << FormulaName(result.formula) << "\", ";
+			file << "\"precision\": \"" << PrecisionTierName(result.precision) << "\", ";
+			file << "\"backend\": \"" << BACKEND_NAMES[static_cast<std::size_t>(result.backend)] << "\", ";
+
+			if (result.backend == Backend::GL)
+			{
+				file << "\"workgroup\": \"" << result.kernel.workgroupSizeX << "x" << result.kernel.workgroupSizeY << "\", ";
+				file << "\"ilp\": " << result.kernel.ilpFactor << ", ";
+				file << "\"dispatch\": \"" << DispatchModeName(result.kernel.dispatchMode) << "\", ";
+			}
+
+			// GL only knows the budget, an upper bound that can't be compared with counted iterations
+			const char* iterations = result.backend == Backend::GL ? "iterationBudget" : "iterations";
+
+			file << "\"pixels\": " << result.pixels << ", ";
+			file << "\"" << iterations << "\": " << result.iterations << ", ";
+			file << "\"medianSeconds\": " << median << ", ";
+			file << "\"minSeconds\": " << *std::min_element(result.seconds.begin(), result.seconds.end()) << ", ";
+			file << "\"maxSeconds\": " << *std::max_element(result.seconds.begin(), result.seconds.end()) << ", ";
+			file << "\"pixelsPerSecond\": " << result.pixels / median << ", ";
+			file << "\"" << iterations << "PerSecond\": " << result.iterations / median;
+			file << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+
+		file << "\t]\n";
+		file << "}\n";
+
+		if (!file.good())
+		{
+			throw std::runtime_error("Failed to write results: " + path);
+		}
+	}
+
+	// Nearest-rank percentile
+	double Percentile(std::vector<double> values, double percent)
+	{
+		std::sort(values.begin(), values.end());
+		std::size_t rank = static_cast<std::size_t>(std::ceil(percent / 100.0 * values.size()));
+		return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+	}
+
+	double Sum(const std::vector<double>& values)
+	{
+		double sum = 0.0;
+		for (double value : values) sum += value;
+		return sum;
+	}
+
+	void WriteSeconds(std::ostream& file, const char* name, const std::vector<double>& values)
+	{
+		file << "\"" << name << "\": [";
+
+		for (std::size_t i = 0; i < values.size(); i++)
+		{
+			file << (i > 0 ? ", " : "") << values[i] * 1e3;
+		}
+
+		file << "]";
+	}
+
+	void WriteDiveReport(const std::string& path, const Options& options, const std::string& renderer, const std::vector<DiveResult>& results)
+	{
+		std::ofstream file(path);
+		file << std::setprecision(6);
+
+		file << "{\n";
+		file << "\t\"pack\": " << JsonString(options.pack) << ",\n";
+		file << "\t\"width\": " << options.width << ",\n";
+		file << "\t\"height\": " << options.height << ",\n";
+		file << "\t\"zoomStep\": " << options.zoomStep << ",\n";
+		file << "\t\"workgroup\": \"" << options.kernels.front().workgroupSizeX << "x" << options.kernels.front().workgroupSizeY << "\",\n";
+		file << "\t\"ilp\": " << options.kernels.front().ilpFactor << ",\n";
+		file << "\t\"dispatch\": \"" << DispatchModeName(options.kernels.front().dispatchMode) << "\",\n";
+		file << "\t\"threads\": " << options.threads << ",\n";
+		file << "\t\"glRenderer\": " << JsonString(renderer) << ",\n";
+		file << "\t\"dives\": [\n";
+
+		// Times are in milliseconds
+		for (std::size_t i = 0; i < results.size(); i++)
+		{
+			const DiveResult& result = results[i];
+
+			file << "\t\t{ ";
+			file << "\"level\": " << result.level << ", ";
+			file << "\"target\": " << result.target << ", ";
+			file << "\"formula\": \"" << FormulaName(result.formula) << "\", ";
+			file << "\"precision\": \"" << PrecisionTierName(result.precision) << "\", ";
+			file << "\"backend\": \"" << BACKEND_NAMES[static_cast<std::size_t>(result.backend)] << "\", ";
+			file << "\"steps\": " << result.frameSeconds.size() << ", ";
+			file << "\"firstFrameMs\": " << result.firstFrameSeconds * 1e3 << ", ";
+			file << "\"p50Ms\": " << Percentile(result.frameSeconds, 50.0) * 1e3 << ", ";
+			file << "\"p95Ms\": " << Percentile(result.frameSeconds, 95.0) * 1e3 << ", ";
+			file << "\"p99Ms\": " << Percentile(result.frameSeconds, 99.0) * 1e3 << ", ";
+			file << "\"cpuMs\": " << Sum(result.cpuSeconds) * 1e3 << ", ";
+			file << "\"gpuMs\": " << Sum(result.gpuSeconds) * 1e3 << ",\n\t\t\t";
+			WriteSeconds(file, "frameMs", result.frameSeconds);
+			file << ",\n\t\t\t";
+			WriteSeconds(file, "cpuStepMs", result.cpuSeconds);
+			file << ",\n\t\t\t";
+			WriteSeconds(file, "gpuStepMs", result.gpuSeconds);
+			file << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+
+		file << "\t]\n";
+		file << "}\n";
+
+		if (!file.good())
+		{
+			throw std::runtime_error("Failed to write results: " + path);
+		}
+	}
+
+	void RunKernels(const Options& options, GlBench* gl, const std::string& renderer)
+	{
+		std::vector<Workload> workloads = LoadWorkloads(options);
+		std::vector<Result> results;
+		using Clock = std::chrono::steady_clock;
+
+		for (const Workload& workload : workloads)
+		for (Backend backend : options.backends)
+		{
+			Formula formula = workload.formula;
+			PrecisionTier precision = workload.precision;
+
+			// Levels run on the GPU the way the game runs them, higher tiers at double precision
+			if (backend == Backend::GL && workload.level >= 0) precision = GpuPrecision(precision);
+			const std::vector<Viewport>& viewports = workload.viewports;
+
+			if (backend == Backend::GL && (!gl || !GlBench::Supports(precision))) continue;
+
+			// Kernel variants only apply to GL, the CPU backends run once
+			std::size_t variants = backend == Backend::GL ? options.kernels.size() : 1;
+
+			for (std::size_t v = 0; v < variants; v++)
+			{
+				const KernelConfig& kernel = options.kernels[v];
+				UInt program = backend == Backend::GL ? gl->CreateProgram(kernel, formula, precision) : 0;
+
+				Result result { workload.level, formula, precision, backend, kernel, 0, 0, {} };
+				result.pixels = static_cast<std::uint64_t>(options.width) * options.height * viewports.size();
+
+				for (std::uint32_t run = 0; run < options.warmup + options.repeat; run++)
+				{
+					auto start = Clock::now();
+
+					result.iterations = backend == Backend::GL ?
+						gl->Render(program, precision, viewports) :
+						RenderCpu(options, formula, precision, backend, viewports);
+
+					std::chrono::duration<double> elapsed = Clock::now() - start;
+					if (run >= options.warmup) result.seconds.push_back(elapsed.count());
+				}
+
+				if (program != 0) glDeleteProgram(program);
+
+				std::ostringstream variant;
+				if (backend == Backend::GL) variant << kernel.workgroupSizeX << "x" << kernel.workgroupSizeY << " ilp" << kernel.ilpFactor << " " << DispatchModeName(kernel.dispatchMode);
+
+				double median = Median(result.seconds);
+				if (workload.level >= 0) std::cout << std::setw(6) << std::left << workload.level;
+
+				std::cout <<
+					std::setw(12) << std::left << FormulaName(formula) <<
+					std::setw(14) << PrecisionTierName(precision) <<
+					std::setw(8) << BACKEND_NAMES[static_cast<std::size_t>(backend)] <<
+					std::setw(24) << variant.str() <<
+					std::setw(12) << std::right << std::fixed << std::setprecision(2) << result.pixels / median / 1e6 << " Mpx/s" <<
+					std::setw(12) << result.iterations / median / 1e6 << (backend == Backend::GL ? " Mit/s budget" : " Mit/s") << std::endl;
+
+				results.push_back(result);
+			}
+		}
+
+		WriteKernelReport(options.out, options, renderer, results);
+		std::cout << "Wrote " << results.size() << " results to " << options.out << std::endl;
+	}
+
+	std::size_t CountDifferences(const std::uint16_t* a, const std::uint16_t* b, std::size_t count)
+	{
+		std::size_t differences = 0;
+
+		for (std::size_t i = 0; i < count; i++)
+		{
+			if (a[i] != b[i]) differences++;
+		}
+
+		return differences;
+	}
+
+	// Returns false if any kernel variant's dwell differs from the reference grid kernel's
+	bool RunVerify(const Options& options, GlBench& gl)
+	{
+		std::vector<Workload> workloads = LoadWorkloads(options);
+		const std::size_t pixels = static_cast<std::size_t>(options.width) * options.height;
+		const std::vector<std::uint16_t> unwritten(pixels, UNWRITTEN);
+
+		// One invocation per pixel, nothing shared between pixels
+		KernelConfig reference;
+		reference.workgroupSizeX = 1;
+		reference.workgroupSizeY = 1;
+
+		std::uint32_t variants = 0;
+		std::uint32_t failures = 0;
+
+		for (const Workload& workload : workloads)
+		{
+			Formula formula = workload.formula;
+			PrecisionTier precision = workload.level >= 0 ? GpuPrecision(workload.precision) : workload.precision;
+			const std::vector<Viewport>& viewports = workload.viewports;
+
+			if (!GlBench::Supports(precision)) continue;
+
+			UInt program = gl.CreateProgram(reference, formula, precision);
+			std::vector<std::vector<std::uint16_t>> expected;
+
+			for (const Viewport& view : viewports)
+			{
+				expected.push_back(gl.Capture(program, precision, view));
+
+				if (std::count(expected.back().begin(), expected.back().end(), UNWRITTEN) != 0)
+				{
+					throw std::runtime_error("Reference kernel left pixels unwritten");
+				}
+			}
+
+			glDeleteProgram(program);
+
+			for (const KernelConfig& kernel : options.kernels)
+			{
+				std::size_t whole = 0;
+				std::size_t sliced = 0;
+				program = gl.CreateProgram(kernel, formula, precision);
+
+				for (std::size_t i = 0; i < viewports.size(); i++)
+				{
+					whole += CountDifferences(expected[i].data(), gl.Capture(program, precision, viewports[i]).data(), pixels);
+					sliced += CountDifferences(expected[i].data(), gl.Capture(program, precision, viewports[i], SLICE_ROWS).data(), pixels);
+				}
+
+				glDeleteProgram(program);
+				bool failed = whole != 0 || sliced != 0;
+
+				// Layered kernels only come as grid dispatches
+				std::ostringstream layered;
+
+				if (kernel.dispatchMode == DispatchMode::Grid)
+				{
+					KernelConfig layeredKernel = kernel;
+					layeredKernel.layered = true;
+					program = gl.CreateProgram(layeredKernel, formula, precision);
+					std::size_t differences = 0;
+					std::size_t next = 0;
+
+					for (std::size_t dispatch = 0; next < viewports.size(); dispatch++)
+					{
+						// Every other dispatch flags a different layer off, as the game does for baked previews
+						std::size_t skipped = dispatch % 2 ? dispatch / 2 % MAX_KERNEL_LAYERS : MAX_KERNEL_LAYERS;
+						const Viewport* views[MAX_KERNEL_LAYERS] = {};
+						std::size_t indices[MAX_KERNEL_LAYERS] = {};
+						const Viewport* first = nullptr;
+
+						for (std::size_t layer = 0; layer < MAX_KERNEL_LAYERS && next < viewports.size(); layer++)
+						{
+							if (layer == skipped) continue;
+							if (first != nullptr && viewports[next].iterations != first->iterations) break;
+
+							views[layer] = &viewports[next];
+							indices[layer] = next++;
+							if (first == nullptr) first = views[layer];
+						}
+
+						std::vector<std::uint16_t> dwell = gl.CaptureLayers(program, views);
+
+						for (std::size_t layer = 0; layer < MAX_KERNEL_LAYERS; layer++)
+						{
+							const std::uint16_t* want = views[layer] != nullptr ? expected[indices[layer]].data() : unwritten.data();
+							differences += CountDifferences(want, dwell.data() + layer * pixels, pixels);
+						}
+					}
+
+					glDeleteProgram(program);
+					layered << differences;
+					failed = failed || differences != 0;
+				}
+				else
+				{
+					layered << "-";
+				}
+
+				variants++;
+				if (failed) failures++;
+
+				std::ostringstream variant;
+				variant << kernel.workgroupSizeX << "x" << kernel.workgroupSizeY << " ilp" << kernel.ilpFactor << " " << DispatchModeName(kernel.dispatchMode);
+				if (workload.level >= 0) std::cout << std::setw(6) << std::left << workload.level;
+
+				std::cout <<
+					std::setw(12) << std::left << FormulaName(formula) <<
+					std::setw(14) << PrecisionTierName(precision) <<
+					std::setw(24) << variant.str() <<
+					std::setw(10) << std::right << whole << " whole" <<
+					std::setw(10) << sliced << " sliced" <<
+					std::setw(10) << layered.str() << " layered" << std::endl;
+			}
+		}
+
+		if (failures != 0)
+		{
+			std::cout << failures << " of " << variants << " kernel variants differ from the reference, counts are differing pixels" << std::endl;
+			return false;
+		}
+
+		std::cout << "All " << variants << " kernel variants match the reference" << std::endl;
+		return true;
+	}
+
+	void RunDives(const Options& options, GlBench* gl, const std::string& renderer)
+	{
+		LevelPack pack;
+		if (!pack.Open(options.pack) || pack.GetLevelCount() == 0)
+		{
+			throw std::runtime_error("Failed to load level pack: " + options.pack);
+		}
+
+		Backend backend = options.backends.size() == 1 ? options.backends.front() : Backend::GL;
+		if (backend == Backend::GL && !gl) backend = Backend::Simd;
+
+		std::vector<DiveResult> results;
+		using Clock = std::chrono::steady_clock;
+
+		for (std::uint32_t i = 0; i < pack.GetLevelCount(); i++)
+		{
+			const LevelRecord& record = pack.GetLevel(i);
+			PrecisionTier precision = backend == Backend::GL ? GpuPrecision(record.precision) : record.precision;
+
+			for (std::uint32_t t = 0; t < 4; t++)
+			{
+				DiveResult result { i, t, record.formula, precision, backend, 0.0, {}, {}, {} };
+				Viewport view { record.offsets[t][0], record.offsets[t][1], DEFAULT_ZOOM, static_cast<std::int32_t>(record.iterationBudget) };
+
+				// Counts getting the level's program ready, as loading a level would
+				auto start = Clock::now();
+				UInt program = backend == Backend::GL ? gl->CreateProgram(options.kernels.front(), record.formula, precision) : 0;
+
+				// Zoom in until the target is as large on screen as it is meant to be found at
+				for (bool last = false; !last; view.size *= options.zoomStep)
+				{
+					last = view.size * options.zoomStep < record.zooms[t];
+
+					auto frameStart = Clock::now();
+					double gpuSeconds = 0.0;
+
+					if (backend == Backend::GL)
+					{
+						gpuSeconds = gl->RenderTimed(program, precision, view);
+					}
+					else
+					{
+						RenderCpu(options, record.formula, precision, backend, { view });
+					}
+
+					auto frameEnd = Clock::now();
+					std::chrono::duration<double> frame = frameEnd - frameStart;
+
+					if (result.frameSeconds.empty())
+					{
+						result.firstFrameSeconds = std::chrono::duration<double>(frameEnd - start).count();
+					}
+
+					result.frameSeconds.push_back(frame.count());
+					result.gpuSeconds.push_back(gpuSeconds);
+					// GPU work is waited on at the end of every frame, CPU time is what's left
+					result.cpuSeconds.push_back(std::max(0.0, frame.count() - gpuSeconds));
+				}
+
+				if (program != 0) glDeleteProgram(program);
+
+				std::cout <<
+					"level " << std::setw(3) << std::left << i <<
+					"target " << t << "  " <<
+					std::setw(12) << FormulaName(record.formula) <<
+					std::setw(5) << std::right << result.frameSeconds.size() << " frames" <<
+					std::fixed << std::setprecision(2) <<
+					std::setw(10) << result.firstFrameSeconds * 1e3 << " ms first" <<
+					std::setw(10) << Percentile(result.frameSeconds, 50.0) * 1e3 << " ms p50" <<
+					std::setw(10) << Percentile(result.frameSeconds, 99.0) * 1e3 << " ms p99" << std::endl;
+
+				results.push_back(result);
+			}
+		}
+
+		WriteDiveReport(options.out, options, renderer, results);
+		std::cout << "Wrote " << results.size() << " dives to " << options.out << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		Options options = ParseOptions(argc, argv);
+
+		bool wantGl = options.gl && std::find(options.backends.begin(), options.backends.end(), Backend::GL) != options.backends.end();
+		std::unique_ptr<GlBench> gl;
+		std::string renderer = "none";
+
+		if (wantGl)
+		{
+			try
+			{
+				gl.reset(new GlBench(options.width, options.height));
+				renderer = gl->GetRenderer();
+			}
+			catch (const std::exception& e)
+			{
+				std::cout << "GL backend unavailable, skipping: " << e.what() << std::endl;
+			}
+		}
+
+		if (options.verify)
+		{
+			if (!gl) throw std::runtime_error("--verify needs the GL backend");
+			if (!RunVerify(options, *gl)) return 1;
+		}
+		else if (options.dive)
+		{
+			RunDives(options, gl.get(), renderer);
+		}
+		else
+		{
+			RunKernels(options, gl.get(), renderer);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -1,166 +1,356 @@
 #include "Game.hpp"
 
-#include "ValkyrieEngineCommon/Content.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "glad/glad.h"
 #include <chrono>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <thread>
 
 using namespace game;
 
-constexpr float defaultZoom = 2.f;
+constexpr double defaultZoom = 2.0;
 
-void LoadShader(const std::string& path, const std::string& alias)
+// How long an idle frame sleeps, input is still polled at this rate
+constexpr auto IDLE_SLEEP = std::chrono::milliseconds(16);
+
+// Updates a level takes to appear or disappear, whatever its iteration budget
+constexpr UInt TRANSITION_UPDATES = 60;
+
+const char* const TRANSITION_NAMES[] =
 {
-	if (!Content<GLSLFile>::LoadContent(path, alias))
+	"band",
+	"fade",
+	"dissolve",
+};
+
+static_assert(sizeof(TRANSITION_NAMES) / sizeof(TRANSITION_NAMES[0]) == static_cast<std::size_t>(Transition::Count), "Transition name table out of date");
+
+// Texture and image unit of the preview array
+constexpr UInt PREVIEW_UNIT = 1;
+
+// Texture unit of the current palette, after the fractal, previews and end screen
+constexpr UInt PALETTE_UNIT = 6;
+
+// Texture units of the four baked previews
+constexpr UInt BAKED_PREVIEW_UNIT = 7;
+
+// Texture unit prefetched textures are bound to while they're filled, nothing samples it
+constexpr UInt PREFETCH_UNIT = 11;
+
+// Pixels of the next level's starting view rendered per prefetch slice
+constexpr UInt PREFETCH_SLICE_PIXELS = 1 << 16;
+
+// Side of the square tiles a budgeted frame is rendered in
+constexpr UInt TILE_SIZE = 128;
+
+// Tiles a budgeted frame renders before there's a measurement of what one costs
+constexpr UInt FIRST_TILE_BATCH = 8;
+
+// Fractal work is timed per this many pixels, which doesn't depend on the tile size or scale
+constexpr UInt PIXELS_PER_WORK = 1024;
+
+// Lowest render scale dynamic resolution drops to, along each axis
+constexpr float MIN_RENDER_SCALE = 0.5f;
+
+// Sharpening of images upscaled from a reduced render scale
+constexpr float UPSCALE_SHARPNESS = 0.5f;
+
+// Texture unit of the supersampled pixels' sample index, and the image unit the kernel writes it through
+constexpr UInt SAMPLE_INDEX_UNIT = 12;
+constexpr UInt SAMPLE_INDEX_IMAGE_UNIT = 2;
+
+// Boundaries are usually well under a fifth of the view, past a quarter they keep one sample
+constexpr UInt BOUNDARY_CAPACITY_DIVISOR = 4;
+
+// Texture unit of the accumulated colours
+constexpr UInt ACCUMULATION_UNIT = 13;
+
+Window* CreateSharedContext(Window* window)
+{
+	WindowHints hints {};
+	hints.title = u8"Fractal Finder Shader Compiler";
+	hints.contextAPI = ContextAPI::OpenGL;
+	hints.contextVersionMajor = 4;
+	hints.contextVersionMinor = 3;
+	hints.visible = false;
+	hints.shareContext = window;
+
+	Window* context = nullptr;
+
+	try
 	{
-		throw std::runtime_error("Failed to load shader: " + path);
+		context = Component<Window>::Create(1, hints);
 	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Failed to create shared context, compiling shaders on demand: " << e.what() << std::endl;
+	}
+
+	// Creating a window may change the current context
+	window->MakeContextCurrent();
+	return context;
+}
+
+// Truncated like the textures, so scale 1 is exactly the view
+UInt ScaledSize(float size, float scale)
+{
+	return std::max(1u, static_cast<UInt>(size * scale));
+}
+
+void SetNearestClamp(GLenum target)
+{
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 }
 
-void CheckProgramError(UInt program)
+// Element index of the Halton sequence in base, spread evenly over [0, 1) for any prefix
+float Halton(UInt index, UInt base)
 {
-	Int success = 0;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE)
+	float result = 0.f;
+	float fraction = 1.f / base;
+
+	for (; index > 0; index /= base)
 	{
-		Int logLength = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-		char* infoLog = new char[logLength];
-		glGetProgramInfoLog(program, logLength, &logLength, infoLog);
-		std::cout << "Failed to compile shader program:\n" << infoLog << std::endl;
-		delete[] infoLog;
-		throw std::runtime_error("Failed to compile shader program.");
+		result += fraction * (index % base);
+		fraction /= base;
 	}
+
+	return result;
 }
 
-void CheckShaderError(UInt shader)
+void ReadLevel(const LevelRecord& record, Level& level)
 {
-	Int success = 0;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-	if (success == GL_FALSE)
+	level.formula = record.formula;
+	level.precision = record.precision;
+	level.iterationBudget = record.iterationBudget;
+
+	for (UInt i = 0; i < 4; i++)
 	{
-		Int logLength = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-		char* infoLog = new char[logLength];
-		glGetShaderInfoLog(shader, logLength, &logLength, infoLog);
-		std::cout << "Failed to compile shader:\n" << infoLog << std::endl;
-		delete[] infoLog;
-		throw std::runtime_error("Failed to compile shader.");
+		level.zooms[i] = record.zooms[i];
+		level.offsets[i].x = record.offsets[i][0];
+		level.offsets[i].y = record.offsets[i][1];
 	}
 }
 
-UInt CreateComputeProgram(const std::string& source)
+// Baked previews are already coloured and keep the size they were baked at
+void UploadBakedPreview(UInt unit, UInt texture, const AssetRef& asset, const std::uint8_t* baked)
 {
-	const char* cstr = Content<GLSLFile>::GetContent(source)->data.c_str();
-	
-	UInt program = glCreateShaderProgramv(GL_COMPUTE_SHADER,1, &cstr);
-	CheckProgramError(program);
-
-	return program;
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(
+		GL_TEXTURE_2D,
+		0,
+		GL_RGBA8,
+		asset.width,
+		asset.height,
+		0,
+		GL_RGBA,
+		GL_UNSIGNED_BYTE,
+		baked);
 }
 
-UInt CreateShader(const std::string& source, UInt usage)
+// Renders the layers of array whose view is flagged, with the layered program bound
+void DispatchPreviews(const KernelConfig& kernel, WorkQueue& queue, UInt viewBuffer, UInt array, const double (&views)[MAX_KERNEL_LAYERS][4], const Vector2& size)
 {
-	const GLSLFile* glsl = Content<GLSLFile>::GetContent(source);
-	auto cstr = glsl->data.c_str();
-	UInt shader = glCreateShader(usage);
-	glShaderSource(shader, 1, &cstr, nullptr);
-	glCompileShader(shader);
-	CheckShaderError(shader);
-	return shader;
+	glBindBuffer(GL_UNIFORM_BUFFER, viewBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(views), views);
+
+	glBindImageTexture(PREVIEW_UNIT, array, 0, true, 0, GL_WRITE_ONLY, GL_R16UI);
+	glUniform1i(0, PREVIEW_UNIT); // Bind default texture
+	DispatchKernel(kernel, queue, size[0], size[1], MAX_KERNEL_LAYERS);
+
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-UInt CreateGraphicsProgram(const std::string& vertexSource, const std::string& fragmentSource)
+// The level's kernel finding and sampling the boundaries of its image
+KernelConfig SupersampleKernel(const KernelConfig& kernel)
 {
-	UInt vertexShader = CreateShader(vertexSource, GL_VERTEX_SHADER);
-	UInt fragmentShader = CreateShader(fragmentSource, GL_FRAGMENT_SHADER);
+	KernelConfig config = kernel;
+	config.dispatchMode = DispatchMode::Grid;
+	config.supersample = true;
+	return config;
+}
 
-	UInt program = glCreateProgram();
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
-	glLinkProgram(program);
-	CheckProgramError(program);
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-	return program;
+void SetViewUniforms(PrecisionTier precision, double zoom, const WorldPoint& offset)
+{
+	if (GpuPrecision(precision) == PrecisionTier::Double)
+	{
+		glUniform1d(2, zoom);
+		glUniform2d(3, offset.x, offset.y);
+	}
+	else
+	{
+		glUniform1f(2, static_cast<float>(zoom));
+		glUniform2f(3, static_cast<float>(offset.x), static_cast<float>(offset.y));
+	}
 }
 
-Game::Game(Window* _window) :
-	window(_window)
+Game::Game(Window* _window, const GameOptions& options) :
+	window(_window),
+	shaderCache("shadercache"),
+	shaderCompiler(CreateSharedContext(_window)),
+	fractalOutputs {},
+	frameFences {},
+	frameQueueDepth(std::max(1u, std::min(options.frameQueueDepth, MAX_FRAMES_IN_FLIGHT))),
+	frameIndex(0),
+	kernelConfig(options.kernel),
+	renderOnDemand(options.renderOnDemand),
+	fractalValid(false),
+	frameBudget(options.frameBudget),
+	tilesLeft(0),
+	nextTile(0),
+	resolutionTarget(options.resolutionTarget),
+	displayedScale(1.f),
+	supersample(options.supersample),
+	boundaryThreshold(options.boundaryThreshold),
+	boundaryBuffer(0),
+	boundaryCapacity(0),
+	sampleIndexTexture(0),
+	supersampleValid(false),
+	// Whole jittered frames would blow the budget every frame
+	accumulateFrames(options.frameBudget > 0.f ? 0 : options.accumulateFrames),
+	accumulationTexture(0),
+	accumulationFramebuffer(0),
+	jitterOutput(0),
+	accumulatedFrames(0),
+	displayedOutput(0),
+	screenChanged(true),
+	palette(options.palette),
+	paletteOffset(0.f),
+	paletteCycle(options.paletteCycle),
+	palettePeriod(options.palettePeriod),
+	transition(options.transition),
+	replaying(false),
+	printGpuTimings(options.printGpuTimings)
 {
+	if (options.accumulateFrames > 0 && (options.frameBudget > 0.f || options.paletteCycle != 0.f))
+	{
+		std::cout << "Frames are never accumulated with a frame budget or a cycling palette" << std::endl;
+	}
+
+	if (!levelPack.Open(options.levelPack) || levelPack.GetLevelCount() == 0)
+	{
+		throw std::runtime_error("Failed to load level pack: " + options.levelPack);
+	}
+
 	Content<GLSLFile>::SetContentPrefix("res/");
-	LoadShader("mandelbrot.glsl", "mandelbrot");
-	LoadShader("julia0.glsl", "julia0");
-	LoadShader("julia1.glsl", "julia1");
-	LoadShader("julia2.glsl", "julia2");
-	LoadShader("tricorn.glsl", "tricorn");
-	LoadShader("burning.glsl", "burning");
+	LoadShader("fractal.glsl", "fractal");
 	LoadShader("vertex.glsl", "vertex");
 	LoadShader("fragment.glsl", "fragment");
-	mandelProgram = CreateComputeProgram("mandelbrot");
-	juliaProgram0 = CreateComputeProgram("julia0");
-	juliaProgram1 = CreateComputeProgram("julia1");
-	juliaProgram2 = CreateComputeProgram("julia2");
-	tricornProgram = CreateComputeProgram("tricorn");
-	burningProgram = CreateComputeProgram("burning");
-	quadProgram = CreateGraphicsProgram("vertex", "fragment");
+	LoadShader("colorize.glsl", "colorize");
+
+	// Programs are queued a level at a time, the first level's when it loads and every later
+	// level's when its prefetch starts, so they're compiled in the background while the one
+	// before it is played
+	shaderCompiler.Start();
+
+	quadProgram = CreateGraphicsProgram(shaderCache, "vertex", "fragment");
+	colorizeProgram = CreateGraphicsProgram(shaderCache, "vertex", "colorize", "#define SUPERSAMPLES " + std::to_string(SUPERSAMPLES) + "\n");
+	previewProgram = CreateGraphicsProgram(shaderCache, "vertex", "colorize", "#define LAYERED\n");
 
 	auto windowSize = window->GetSize();
 	fullSize = Vector2(windowSize[0], windowSize[1]);
-	viewSize = Vector2(fullSize[0] * 0.8f, fullSize[1]);
+	// Whole pixels, the textures, dispatches and present pass all have to agree on the size
+	viewSize = Vector2(std::floor(fullSize[0] * 0.8f), fullSize[1]);
 
 	previewSize = Vector2(fullSize[0] - viewSize[0], viewSize[1] / 4.f);
 
-	glGenTextures(1, &fractalOutput);
-	glActiveTexture(GL_TEXTURE0 + 0);
-	glBindTexture(GL_TEXTURE_2D, fractalOutput);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexImage2D(
-		GL_TEXTURE_2D, 
-		0, 
-		GL_RGBA32F, 
-		viewSize[0], 
-		viewSize[1], 
-		0, 
-		GL_RGBA, 
-		GL_FLOAT, 
-		nullptr);
-	glBindImageTexture(0, fractalOutput, 0, false, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-	glGenTextures(4, previewTextures);
-	for (UInt i = 0; i < 4; i++)
+	glGenTextures(frameQueueDepth, fractalOutputs);
+	for (UInt i = 0; i < frameQueueDepth; i++)
 	{
-		glActiveTexture(GL_TEXTURE1 + i);
-		glBindTexture(GL_TEXTURE_2D, previewTextures[i]);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glActiveTexture(GL_TEXTURE0 + 0);
+		glBindTexture(GL_TEXTURE_2D, fractalOutputs[i]);
+		SetNearestClamp(GL_TEXTURE_2D);
 		glTexImage2D(
 			GL_TEXTURE_2D, 
 			0, 
-			GL_RGBA32F, 
-			previewSize[0], 
-			previewSize[1], 
+			GL_R16UI, 
+			viewSize[0], 
+			viewSize[1], 
 			0, 
-			GL_RGBA, 
-			GL_FLOAT, 
+			GL_RED_INTEGER, 
+			GL_UNSIGNED_SHORT, 
 			nullptr);
-		glBindImageTexture(
-			i + 1,
-			previewTextures[i], 
-			0, 
-			false, 
-			0, 
-			GL_WRITE_ONLY, 
-			GL_RGBA32F);
+	}
+
+	// Rebound to the current frame's output before every dispatch
+	glBindImageTexture(0, fractalOutputs[0], 0, false, 0, GL_WRITE_ONLY, GL_R16UI);
+
+	if (supersample)
+	{
+		boundaryCapacity = static_cast<UInt>(viewSize[0] * viewSize[1]) / BOUNDARY_CAPACITY_DIVISOR;
+
+		// The colorize pass reads the samples from the binding the kernel writes them to
+		glGenBuffers(1, &boundaryBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundaryBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(BoundaryBufferSize(boundaryCapacity)), nullptr, GL_DYNAMIC_COPY);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, boundaryBuffer);
+
+		glGenTextures(1, &sampleIndexTexture);
+		glActiveTexture(GL_TEXTURE0 + SAMPLE_INDEX_UNIT);
+		glBindTexture(GL_TEXTURE_2D, sampleIndexTexture);
+		SetNearestClamp(GL_TEXTURE_2D);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, viewSize[0], viewSize[1], 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	}
+
+	if (accumulateFrames > 0)
+	{
+		// Sums of a few hundred frames need more precision than half floats have
+		glGenTextures(1, &accumulationTexture);
+		glActiveTexture(GL_TEXTURE0 + ACCUMULATION_UNIT);
+		glBindTexture(GL_TEXTURE_2D, accumulationTexture);
+		SetNearestClamp(GL_TEXTURE_2D);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, viewSize[0], viewSize[1], 0, GL_RGBA, GL_FLOAT, nullptr);
+
+		glGenFramebuffers(1, &accumulationFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, accumulationFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulationTexture, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		glGenTextures(1, &jitterOutput);
+		glActiveTexture(GL_TEXTURE0 + PREFETCH_UNIT);
+		glBindTexture(GL_TEXTURE_2D, jitterOutput);
+		SetNearestClamp(GL_TEXTURE_2D);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, viewSize[0], viewSize[1], 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+	}
+
+	// Rendered previews go into the layers of one array, filled by a single dispatch
+	glGenTextures(1, &previewArray);
+	glActiveTexture(GL_TEXTURE0 + PREVIEW_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, previewArray);
+	SetNearestClamp(GL_TEXTURE_2D_ARRAY);
+	glTexImage3D(
+		GL_TEXTURE_2D_ARRAY,
+		0,
+		GL_R16UI,
+		previewSize[0],
+		previewSize[1],
+		4,
+		0,
+		GL_RED_INTEGER,
+		GL_UNSIGNED_SHORT,
+		nullptr);
+
+	// Each layer's view, read by the layered kernel
+	glGenBuffers(1, &previewViewBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, previewViewBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(double) * 4 * MAX_KERNEL_LAYERS, nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, previewViewBuffer);
+
+	// Baked previews are already coloured and keep the size they were baked at
+	glGenTextures(4, bakedPreviews);
+	for (UInt i = 0; i < 4; i++)
+	{
+		previewBaked[i] = false;
+		glActiveTexture(GL_TEXTURE0 + BAKED_PREVIEW_UNIT + i);
+		glBindTexture(GL_TEXTURE_2D, bakedPreviews[i]);
+		SetNearestClamp(GL_TEXTURE_2D);
 	}
 
 	int width, height;
@@ -194,6 +384,11 @@ Game::Game(Window* _window) :
 
 	stbi_image_free(endScreen);
 
+	for (UInt i = 0; i < static_cast<UInt>(Palette::Count); i++)
+	{
+		paletteTextures[i] = CreatePaletteTexture(static_cast<Palette>(i));
+	}
+
 	struct Vertex { Vector2 pos; Vector2 uv; };
 	
 	/*Vertex vertices[3]
@@ -274,228 +469,49 @@ Game::Game(Window* _window) :
 
 	glDisableVertexAttribArray(0);
 	glDisableVertexAttribArray(1);
-	glUseProgram(mandelProgram);
 
 	zoomValue = defaultZoom;
 
 	glClearColor(0.f, 0.f, 0.f, 0.f);
-	numIterations = 0;
-
-	levels[0] =
-	{
-		mandelProgram,
-		{
-			0.00539102f,
-			0.00485192f,
-			0.0556257f,
-			0.0215505f,
-		},
-		{
-			Vector2(-0.56226f, -0.642735f),
-			Vector2(-0.1283f, -0.988242f),
-			Vector2(-0.0584823f, 0.660361f),
-			Vector2(-0.862101f, -0.258372),
-		
-		}
-	};
+	transitionProgress = 0.f;
 
-	levels[1] =
-	{
-		tricornProgram,
-		{
-			0.00676278f,
-			0.00927678f,
-			0.00547786f,
-			0.0500631f,
-		},
-		{
-			Vector2(0.743174f, -0.930051f),
-			Vector2(-1.47725f, 0.0f),
-			Vector2(-1.20453f, -0.079302f),
-			Vector2(0.228252f, -0.529966f),
-		}
-	};
+	gpuTimers.Init();
 
-	levels[2] =
-	{
-		burningProgram,
-		{
-			0.00154711f,
-			0.000739977f,
-			0.00212224f,
-			0.0114528f,
-		},
-		{
-			Vector2(0.970566f, -1.68122f),
-			Vector2(-1.57553f, -0.0369697f),
-			Vector2(-1.86087f, -0.000532295f),
-			Vector2(-0.969854f, -0.989513f),
-		}
-	};
-
-	levels[3] =
-	{
-		juliaProgram1,
-		{
-			0.14358f,
-			0.0556257f,
-			0.0405511f,
-			0.0405511f,
-		},
-		{
-			Vector2(0.523753f, -0.188956f),
-			Vector2(-0.509669f, -0.0752877f),
-			Vector2(-0.075375f, 0.584517f),
-			Vector2(0.225403f, 1.02556f),
-		}
-	};
-
-	levels[4] =
-	{
-		juliaProgram2,
-		{
-			0.19222f,
-			0.0405511f,
-			0.0157103f,
-			0.0618063f,
-		},
-		{
-			Vector2(0.744528f, -0.276319f),
-			Vector2(-1.08141f, -0.45105f),
-			Vector2(0.282748f, 0.680276f),
-			Vector2(-0.689748f, -0.255823f),
-		}
-	};
-
-	levels[5] = 
-	{
-		juliaProgram0,
-		{
-			0.0295617f,
-			0.076304f,
-			0.0399335f,
-			0.0215505
-		},
-		{
-			Vector2(-0.551516f, 0.108391f),
-			Vector2(0.907088f, -0.284514f),
-			Vector2(-0.0433468f, 0.818537f),
-			Vector2(0.0308237f, -0.0408021f)
-		}
-	};
-	
-	levels[6] =
-	{
-		mandelProgram,
-		{
-			0.00834911f,
-			0.000485498f,
-			0.000232213f,
-			0.00323461f,
-		},
-		{
-			Vector2(0.3187f, -0.0321924f),
-			Vector2(-1.76648f, -0.0417347f),
-			Vector2(-1.02001f, 0.367522f),
-			Vector2(-0.398024f, -0.681524f),
-		
-		}
-	};
-
-	levels[7] =
-	{
-		tricornProgram,
-		{
-			0.000111066f,
-			0.00547789f,
-			0.00202005f,
-			0.00013712f,
-		},
-		{
-			Vector2(0.409404f, -1.1384f),
-			Vector2(-1.25785f, -0.0921809f),
-			Vector2(0.596074f, 1.10252f),
-			Vector2(0.767101f, -1.31569f),
-		}
-	};
-
-	levels[8] =
-	{
-		burningProgram,
-		{
-			0.0127253f,
-			0.000665978f,
-			0.000599382f,
-			0.000393255f,
-		},
-		{
-			Vector2(0.480201f, -1.14648f),
-			Vector2(0.375798f, 0.0866547f),
-			Vector2(-1.76489f, -0.0300707f),
-			Vector2(-1.56364f, -0.000174844f),
-		}
-	};
+	gameWon = false;
+	currentLevel = 0;
+	LoadLevel();
+	GeneratePreviews();
+	StartPrefetch();
 
-	levels[9] =
+	if (!options.replayPath.empty())
 	{
-		juliaProgram1,
-		{
-			0.0157103f,
-			0.00323462f,
-			0.00608653f,
-			0.0141394f,
-		},
-		{
-			Vector2(0.231377f, 0.587359f),
-			Vector2(-0.486454f, 1.0161f),
-			Vector2(-0.50049f, -0.750328f),
-			Vector2(-0.132677f, -0.069827f),
-		}
-	};
+		inputReplay.Open(options.replayPath);
+		replaying = true;
 
-	levels[10] =
-	{
-		juliaProgram2,
+		const InputLogHeader& header = inputReplay.GetHeader();
+		if (header.viewWidth != static_cast<UInt>(viewSize[0]) || header.viewHeight != static_cast<UInt>(viewSize[1]))
 		{
-			0.00154711f,
-			0.00927678f,
-			0.000739975f,
-			0.00191001f,
-		},
-		{
-			Vector2(-1.25244f, -0.567376f),
-			Vector2(0.558084f, 0.580386f),
-			Vector2(0.950295f, -0.322775f),
-			Vector2(-1.02154f, 0.270105f),
+			std::cout << "Input log was recorded at " << header.viewWidth << "x" << header.viewHeight <<
+				", replay may diverge" << std::endl;
 		}
-	};
-
-	levels[11] = 
+	}
+	else if (!options.recordPath.empty())
 	{
-		juliaProgram0,
-		{
-			0.0618063f,
-			0.04055110f,
-			0.00154712f,
-			0.0060865f,
-		},
-		{
-			Vector2(-0.325299f, 0.554382f),
-			Vector2(0.375164f, -0.3630710f),
-			Vector2(-1.54658f, 0.11131f),
-			Vector2(-1.44190f, 0.1496010f)
-		}
-	};
+		inputRecorder.Open(options.recordPath, static_cast<UInt>(viewSize[0]), static_cast<UInt>(viewSize[1]));
+	}
 
-	gameWon = false;
-	currentLevel = 0;
-	LoadLevel();
-	GeneratePreviews();
+	lastUpdate = std::chrono::steady_clock::now();
+	lastGpuReport = lastUpdate;
 }
 
 Game::~Game()
 {
+	EvictPrefetch();
 
+	for (GLsync& fence : frameFences)
+	{
+		if (fence) glDeleteSync(fence);
+	}
 }
 
 constexpr inline float MyClamp(float val, float min, float max)
@@ -510,52 +526,62 @@ constexpr inline float MyLerp(float a, float b, float t)
 
 void Game::OnEvent(const UpdateEvent&)
 {
-	if (Keyboard::IsKeyPressed(Key::Escape))
+	InputFrame input = ReadInput();
+
+	if (Keyboard::IsKeyPressed(Key::Escape) || (input.keys & InputKeys::Escape))
 	{
 		window->SetCloseFlag();
 	}
 	
 	if (gameWon) return;
 
-	float scroll = Mouse::GetScrollDelta().Y();
-	zoomValue *= Pow(0.9f, scroll);
+	if (input.keys & InputKeys::NextPalette)
+	{
+		palette = static_cast<Palette>((static_cast<UInt>(palette) + 1) % static_cast<UInt>(Palette::Count));
+		accumulatedFrames = 0;
+		screenChanged = true;
+	}
+
+	// Only the present pass redraws, the fractal isn't touched
+	if (paletteCycle != 0.f)
+	{
+		paletteOffset = std::fmod(paletteOffset + paletteCycle * input.frameMicros * 1e-6f, 1.f);
+		screenChanged = true;
+	}
+
+	zoomValue *= std::pow(0.9, input.scroll);
 
 	//TODO: adjust offset when zooming so the screen stays centered
 	//frame height == 2 * zoom
 	
-	if (Keyboard::IsKeyPressed(Key::Num1)) viewOffset = levels[currentLevel].offsets[0];
-	if (Keyboard::IsKeyPressed(Key::Num2)) viewOffset = levels[currentLevel].offsets[1];
-	if (Keyboard::IsKeyPressed(Key::Num3)) viewOffset = levels[currentLevel].offsets[2];
-	if (Keyboard::IsKeyPressed(Key::Num4)) viewOffset = levels[currentLevel].offsets[3];
+	for (UInt i = 0; i < 4; i++)
+	{
+		if (input.keys & (InputKeys::Num1 << i)) viewOffset = level.offsets[i];
+	}
 
 	// Reset zoom value
-	if (Mouse::IsButtonDown(MouseButton::Middle))
+	if (input.buttons & InputButtons::MiddleDown)
 	{
 		zoomValue = defaultZoom;
-		viewOffset = Vector2();
+		viewOffset = WorldPoint();
 	}
 
-	if (Mouse::IsButtonDown(MouseButton::Right))
+	if (input.buttons & InputButtons::RightDown)
 	{
 		// Amount we need to move
-		auto v = Mouse::GetMouseDelta();
-		
-		viewOffset += Vector2(v[0] * (2.f * zoomValue / viewSize[0]),
-		                      v[1] * (2.f * zoomValue / viewSize[1]));
+		viewOffset.x += input.mouseDelta[0] * (2.0 * zoomValue / viewSize[0]);
+		viewOffset.y += input.mouseDelta[1] * (2.0 * zoomValue / viewSize[1]);
 	}
 
-	if (Mouse::IsButtonPressed(MouseButton::Left))
+	if (input.buttons & InputButtons::LeftPressed)
 	{
-		Vector2 mouse(Mouse::GetMousePos());
-		Vector2 world =  Vector2(mouse[0] * (2.f * zoomValue / viewSize[0]),
-		                         mouse[1] * (2.f * zoomValue / viewSize[1]));
-		world[0] -= zoomValue;
-		world[1] -= zoomValue;
-		world += viewOffset;
+		WorldPoint world;
+		world.x = input.mousePos[0] * (2.0 * zoomValue / viewSize[0]) - zoomValue + viewOffset.x;
+		world.y = input.mousePos[1] * (2.0 * zoomValue / viewSize[1]) - zoomValue + viewOffset.y;
 
 		for (UInt i = 0; i < 4; i++)
 		{
-			if (Vector2::Distance(world, levels[currentLevel].offsets[i]) <= levels[currentLevel].zooms[i] / 2.f)
+			if (std::hypot(world.x - level.offsets[i].x, world.y - level.offsets[i].y) <= level.zooms[i] / 2.0)
 			{
 				std::cout << "Found image: " << i << std::endl;
 				foundImages[i] = true;
@@ -573,7 +599,10 @@ void Game::OnEvent(const UpdateEvent&)
 			for (UInt j = 0; j < 3; j++)
 			{
 				if (texColors[i][j] > 0.f)
-				texColors[i][j] -= 0.05f;
+				{
+					texColors[i][j] -= 0.05f;
+					screenChanged = true;
+				}
 			}
 		}
 		else
@@ -582,58 +611,189 @@ void Game::OnEvent(const UpdateEvent&)
 		}
 	}
 
+	// Transitions only redraw the present pass from the dwell already rendered
+	float transitionStep = 1.f / TRANSITION_UPDATES;
+
 	if (foundAll)
 	{
 		// start fade out
-		numIterations--;
+		transitionProgress = std::max(0.f, transitionProgress - transitionStep);
+		screenChanged = true;
 
-		if (numIterations < 1)
+		if (transitionProgress <= 0.f)
 		{
 			zoomValue = defaultZoom;
-			viewOffset = Vector2();
+			viewOffset = WorldPoint();
 			currentLevel++;
 
-			if (currentLevel == NUM_LEVELS)
+			if (currentLevel == levelPack.GetLevelCount())
 			{
 				currentLevel = 0;
 				gameWon = true;
+				LoadLevel();
+				GeneratePreviews();
+			}
+			else
+			{
+				// Usually prepared in full while the last level was played
+				StartPrefetchedLevel();
+				StartPrefetch();
 			}
-			LoadLevel();
-			GeneratePreviews();
 		}
 	}
-	else if (numIterations < 60)
+	else if (transitionProgress < 1.f)
 	{
-		numIterations++;
+		transitionProgress = std::min(1.f, transitionProgress + transitionStep);
+		screenChanged = true;
 	}
 
 	if (false)
 	{
 		Vector2 mouse(Mouse::GetMousePos());
-		Vector2 world =  Vector2(mouse[0] * (2.f * zoomValue / viewSize[0]),
-		                         mouse[1] * (2.f * zoomValue / viewSize[1]));
-		world[0] -= zoomValue;
-		world[1] -= zoomValue;
-		world += viewOffset;
-		std::cout << "Offset: " << viewOffset[0] << ", " << viewOffset[1] << std::endl;
-		std::cout << "Mouse pos: " << world[0] << ", " << world[1] <<
+		WorldPoint world;
+		world.x = mouse[0] * (2.0 * zoomValue / viewSize[0]) - zoomValue + viewOffset.x;
+		world.y = mouse[1] * (2.0 * zoomValue / viewSize[1]) - zoomValue + viewOffset.y;
+		std::cout << "Offset: " << viewOffset.x << ", " << viewOffset.y << std::endl;
+		std::cout << "Mouse pos: " << world.x << ", " << world.y <<
 		"\nZoom Value: " << zoomValue << "\n";
 	}
 }
 
+InputFrame Game::ReadInput()
+{
+	auto now = std::chrono::steady_clock::now();
+	std::chrono::duration<double, std::micro> elapsed = now - lastUpdate;
+	lastUpdate = now;
+
+	InputFrame input;
+
+	if (replaying)
+	{
+		// Each update times the frame before it, FinishReplay drops the first sample
+		replayFrameTimes.push_back(elapsed.count() / 1000.0);
+
+		if (!inputReplay.Next(input))
+		{
+			FinishReplay();
+			input = InputFrame();
+		}
+
+		return input;
+	}
+
+	input.scroll = Mouse::GetScrollDelta().Y();
+
+	if (Keyboard::IsKeyPressed(Key::Escape)) input.keys |= InputKeys::Escape;
+	if (Keyboard::IsKeyPressed(Key::Num1)) input.keys |= InputKeys::Num1 << 0;
+	if (Keyboard::IsKeyPressed(Key::Num2)) input.keys |= InputKeys::Num1 << 1;
+	if (Keyboard::IsKeyPressed(Key::Num3)) input.keys |= InputKeys::Num1 << 2;
+	if (Keyboard::IsKeyPressed(Key::Num4)) input.keys |= InputKeys::Num1 << 3;
+	if (Keyboard::IsKeyPressed(Key::P)) input.keys |= InputKeys::NextPalette;
+
+	if (Mouse::IsButtonPressed(MouseButton::Left)) input.buttons |= InputButtons::LeftPressed;
+	if (Mouse::IsButtonDown(MouseButton::Right)) input.buttons |= InputButtons::RightDown;
+	if (Mouse::IsButtonDown(MouseButton::Middle)) input.buttons |= InputButtons::MiddleDown;
+
+	if (input.buttons & InputButtons::RightDown)
+	{
+		auto delta = Mouse::GetMouseDelta();
+		input.mouseDelta[0] = delta[0];
+		input.mouseDelta[1] = delta[1];
+	}
+
+	if (input.buttons & InputButtons::LeftPressed)
+	{
+		Vector2 pos(Mouse::GetMousePos());
+		input.mousePos[0] = pos[0];
+		input.mousePos[1] = pos[1];
+	}
+
+	input.frameMicros = static_cast<std::uint32_t>(elapsed.count());
+	inputRecorder.Record(input);
+	return input;
+}
+
+void Game::FinishReplay()
+{
+	replaying = false;
+	window->SetCloseFlag();
+
+	// Drop the first sample, it's the time from startup to the first update
+	std::vector<double> times(replayFrameTimes.begin() + std::min<std::size_t>(1, replayFrameTimes.size()), replayFrameTimes.end());
+	if (times.empty()) return;
+
+	double total = 0.0;
+	for (double time : times) total += time;
+
+	std::sort(times.begin(), times.end());
+	auto percentile = [&](double percent)
+	{
+		std::size_t rank = static_cast<std::size_t>(percent / 100.0 * (times.size() - 1) + 0.5);
+		return times[rank];
+	};
+
+	std::cout << "Replayed " << inputReplay.GetFrameCount() << " frames in " << total << " ms" << std::endl;
+	std::cout << "Frame time p50 " << percentile(50.0) << " ms, p95 " << percentile(95.0) <<
+		" ms, p99 " << percentile(99.0) << " ms, max " << times.back() << " ms" << std::endl;
+	PrintGpuMetrics();
+}
+
+void Game::PrintGpuMetrics() const
+{
+	const GpuMetrics& metrics = gpuTimers.GetMetrics();
+	std::cout << "GPU frame " << metrics.frameMs << " ms";
+
+	for (UInt i = 0; i < static_cast<UInt>(GpuSection::Count); i++)
+	{
+		std::cout << ", " << GpuSectionName(static_cast<GpuSection>(i)) << " " << metrics.sectionMs[i] << " ms";
+	}
+
+	std::cout << " (" << metrics.frames << " frames, " << metrics.dropped << " dropped)" << std::endl;
+}
+
 void Game::OnEvent(const VLFWMain::RenderWaitEvent&)
 {
 	if (window->GetCloseFlag()) return;
-	glFinish();
+
+	// Only wait for the frame that last used the slot we're about to render into, which keeps
+	// at most frameQueueDepth frames queued. A depth of 1 waits for the frame just submitted.
+	GLsync& fence = frameFences[frameIndex];
+	if (!fence) return;
+
+	while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) { }
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+bool SameState(const FractalState& a, const FractalState& b)
+{
+	return a.program == b.program &&
+		a.iterations == b.iterations &&
+		a.zoom == b.zoom &&
+		a.offset.x == b.offset.x &&
+		a.offset.y == b.offset.y &&
+		a.scale == b.scale;
 }
 
 void Game::OnEvent(const PostUpdateEvent&)
 {
-	if (window->GetCloseFlag()) return;
+	if (window->GetCloseFlag())
+	{
+		// Nothing prepared for a level that will never be played is kept around
+		EvictPrefetch();
+		return;
+	}
 
 	auto ifb = window->GetFramebufferSize();
 	Vector2 fb(ifb[0], ifb[1]);
 
+	if (fb[0] != presentedSize[0] || fb[1] != presentedSize[1])
+	{
+		presentedSize = fb;
+		screenChanged = true;
+	}
+
 	float r = fb[0];
 	float l = 0.f;
 	float t = fb[1];
@@ -643,35 +803,167 @@ void Game::OnEvent(const PostUpdateEvent&)
 		0.f, 2.f / (t - b), -(t + b) / (t - b),
 		0.f, 0.f, 1.f);
 
-	if (!gameWon)
+	FractalState state;
+	state.program = currentProgram;
+	state.iterations = level.iterationBudget;
+	state.zoom = zoomValue;
+	state.offset = viewOffset;
+
+	// Only the camera counts as movement, the scale is picked from it
+	bool moving = state.zoom != requestedState.zoom || state.offset.x != requestedState.offset.x || state.offset.y != requestedState.offset.y;
+	state.scale = RenderScale(moving);
+	requestedState = state;
+
+	bool dispatch = !gameWon && (!renderOnDemand || !fractalValid || !SameState(state, renderedState));
+	if (dispatch || !renderOnDemand) screenChanged = true;
+
+	// Rendering the view that's already shown, as --always-render does, doesn't change the image
+	bool imageChanged = dispatch && (!fractalValid || !SameState(state, renderedState));
+
+	gpuTimers.BeginFrame();
+
+	if (dispatch)
 	{
+		UInt output = fractalOutputs[frameIndex];
+
+		glBindImageTexture(0, output, 0, false, 0, GL_WRITE_ONLY, GL_R16UI);
 		glBindVertexArray(computeVAO);
-		glUseProgram(levels[currentLevel].program);
+		glUseProgram(currentProgram);
 		glUniform1i(0, 0); // Bind default texture
-		glUniform1i(1, numIterations); // 60 iterations
-		glUniform1f(2, zoomValue); // Use member zoom
-		glUniform2f(3, viewOffset[0], viewOffset[1]); // Use member offset
-		glDispatchCompute(viewSize[0], viewSize[1], 1); // Dispatch view size
+		glUniform1i(1, level.iterationBudget);
+		SetViewUniforms(level.precision, zoomValue, viewOffset);
+		glUniform2f(11, 0.f, 0.f);
+
+		bool complete = true;
+
+		if (frameBudget > 0.f)
+		{
+			complete = RenderTiles(state, output);
+		}
+		else
+		{
+			// Reduced scales render into the corner of the output, the present pass upscales
+			UInt width = ScaledSize(viewSize[0], state.scale);
+			UInt height = ScaledSize(viewSize[1], state.scale);
+
+			gpuTimers.Begin(GpuSection::Fractal, std::max(1u, width * height / PIXELS_PER_WORK));
+			DispatchKernel(levelKernel, workQueue, width, height);
+			gpuTimers.End();
+		}
 
 		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
+		// Partial images are shown too, the dispatch carries on next frame until it's complete
+		displayedOutput = output;
+		displayedScale = state.scale;
+
+		if (imageChanged)
+		{
+			supersampleValid = false;
+			accumulatedFrames = 0;
+		}
+
+		if (complete)
+		{
+			renderedState = state;
+			fractalValid = true;
+		}
+	}
+
+	// Whether the complete image of the current view was already shown last frame
+	bool still = !imageChanged && fractalValid && SameState(state, renderedState);
+
+	// Boundaries are supersampled once, on the first frame the image is complete and the camera still
+	bool supersampled = supersample && still && !gameWon && !supersampleValid &&
+		displayedScale == 1.f && Supersample();
+	if (supersampled)
+	{
+		accumulatedFrames = 0;
+		screenChanged = true;
+	}
+
+	// Colours only stay put under a still palette, with the level fully shown
+	bool steadyColours = paletteCycle == 0.f && transitionProgress >= 1.f;
+	if (!steadyColours) accumulatedFrames = 0;
+
+	// Frames with nothing else to do accumulate, after the next level is prepared and the
+	// boundaries are supersampled
+	bool accumulated = accumulateFrames > 0 && still && !gameWon && steadyColours &&
+		displayedScale == 1.f && !supersampled && (!supersample || supersampleValid) &&
+		(!prefetch.active || PrefetchDone()) && Accumulate();
+	if (accumulated) screenChanged = true;
+
+	// Back buffers hold nothing after a swap, so the screen is drawn on every frame, only the
+	// fractal dispatch is skipped while nothing changes
+	if (!gameWon)
+	{
+		gpuTimers.Begin(GpuSection::Present);
 		glClear(GL_COLOR_BUFFER_BIT);
 
+		glActiveTexture(GL_TEXTURE0 + 0);
+		glBindTexture(GL_TEXTURE_2D, displayedOutput);
+
+		glActiveTexture(GL_TEXTURE0 + PALETTE_UNIT);
+		glBindTexture(GL_TEXTURE_1D, paletteTextures[static_cast<UInt>(palette)]);
+
 		glBindVertexArray(quadVAO);
-		glUseProgram(quadProgram);
+		glUseProgram(colorizeProgram);
 		glUniform1i(0, 0); // Bind default texture
 		glUniformMatrix3fv(1, 1, true, &ortho[0][0]);
 		glUniform4f(2, 1.f, 1.f, 1.f, 1.f);
+		SetColorizeUniforms(transitionProgress);
+		glUniform2i(15, ScaledSize(viewSize[0], displayedScale), ScaledSize(viewSize[1], displayedScale));
+		glUniform1f(16, UPSCALE_SHARPNESS);
+		glUniform1i(17, SAMPLE_INDEX_UNIT);
+		glUniform1i(18, supersampleValid);
+
+		if (accumulatedFrames > 1)
+		{
+			// The accumulation is already coloured, the weight averages its frames
+			float weight = 1.f / accumulatedFrames;
+
+			glUseProgram(quadProgram);
+			glUniform1i(0, ACCUMULATION_UNIT);
+			glUniformMatrix3fv(1, 1, true, &ortho[0][0]);
+			glUniform4f(2, weight, weight, weight, weight);
+		}
 
 		// Draw big viewport
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 
+		// Rendered previews in one instanced draw over the first preview's quad
+		float layerColors[4][4];
+		Int layerMask = 0;
+
 		for (UInt i = 0; i < 4; i++)
 		{
-			glUniform1i(0, i + 1);
+			for (UInt c = 0; c < 4; c++) layerColors[i][c] = texColors[i][c];
+			if (!previewBaked[i]) layerMask |= 1 << i;
+		}
+
+		glUseProgram(previewProgram);
+		glUniform1i(0, PREVIEW_UNIT);
+		glUniformMatrix3fv(1, 1, true, &ortho[0][0]);
+		SetColorizeUniforms(1.f); // Previews are always fully shown
+		glUniform2f(9, 0.f, previewSize[1]);
+		glUniform4fv(10, 4, &layerColors[0][0]);
+		glUniform1i(14, layerMask);
+		glDrawArraysInstanced(GL_TRIANGLES, 6, 6, 4);
+
+		// Baked previews are already coloured
+		glUseProgram(quadProgram);
+		glUniformMatrix3fv(1, 1, true, &ortho[0][0]);
+
+		for (UInt i = 0; i < 4; i++)
+		{
+			if (!previewBaked[i]) continue;
+
+			glUniform1i(0, BAKED_PREVIEW_UNIT + i);
 			glUniform4fv(2, 1, texColors[i].Data());
 			glDrawArrays(GL_TRIANGLES, 6 * (i + 1), 6);
 		}
+
+		gpuTimers.End();
 	}
 	else
 	{
@@ -680,9 +972,13 @@ void Game::OnEvent(const PostUpdateEvent&)
 		for (UInt i = 0; i < 3; i++)
 		{
 			if (c[i] < 1.f)
+			{
 				c[i] += 0.01f;
+				screenChanged = true;
+			}
 		}
 
+		gpuTimers.Begin(GpuSection::Present);
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		glBindVertexArray(quadVAO);
@@ -693,12 +989,244 @@ void Game::OnEvent(const PostUpdateEvent&)
 
 		// Draw full screen
 		glDrawArrays(GL_TRIANGLES, 30, 6);
+		gpuTimers.End();
+	}
+
+	// The next level only gets frames that didn't render the fractal, one slice each
+	bool prefetched = !gameWon && (!dispatch || !renderOnDemand) && !supersampled && PrefetchSlice();
+
+	gpuTimers.EndFrame();
+
+	bool idle = !dispatch && !screenChanged;
+	screenChanged = false;
+
+	// Idle frames still sleep after a prefetch slice, it's fenced so they can't pile up
+	if (!idle || prefetched)
+	{
+		frameFences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frameIndex = (frameIndex + 1) % frameQueueDepth;
+	}
+
+	if (printGpuTimings && std::chrono::steady_clock::now() - lastGpuReport > std::chrono::seconds(1))
+	{
+		lastGpuReport = std::chrono::steady_clock::now();
+		PrintGpuMetrics();
+	}
+
+	// Replays are timed, so they never sleep
+	if (idle && renderOnDemand && !replaying)
+	{
+		std::this_thread::sleep_for(IDLE_SLEEP);
+	}
+}
+
+Transition game::ParseTransition(const std::string& name)
+{
+	for (std::size_t i = 0; i < static_cast<std::size_t>(Transition::Count); i++)
+	{
+		if (name == TRANSITION_NAMES[i]) return static_cast<Transition>(i);
+	}
+
+	throw std::runtime_error("Unknown transition: " + name);
+}
+
+UInt Game::QueueProgram(const KernelConfig& config)
+{
+	std::string defines = config.Defines();
+	auto it = programJobs.find(defines);
+	if (it != programJobs.end()) return it->second;
+
+	UInt job = shaderCompiler.Add([this, defines]() { return CreateComputeProgram(shaderCache, "fractal", defines); });
+	programJobs[defines] = job;
+	return job;
+}
+
+void Game::Invalidate()
+{
+	fractalValid = false;
+	tilesLeft = 0;
+	supersampleValid = false;
+	accumulatedFrames = 0;
+	screenChanged = true;
+}
+
+bool Game::RenderTiles(const FractalState& state, UInt output)
+{
+	UInt width = viewSize[0];
+	UInt height = viewSize[1];
+	UInt tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	UInt tileCount = tilesX * ((height + TILE_SIZE - 1) / TILE_SIZE);
+
+	if (tilesLeft == 0 || !SameState(state, tiledState))
+	{
+		tiledState = state;
+		tilesLeft = tileCount;
+	}
+
+	// As many tiles as fit the budget at the measured time per pixel. The measurement is a few
+	// frames old, reading it never waits for the GPU.
+	double workMs = gpuTimers.GetMetrics().workMs[static_cast<UInt>(GpuSection::Fractal)];
+	double tileMs = workMs * TILE_SIZE * TILE_SIZE / PIXELS_PER_WORK;
+	UInt batch = tileMs > 0.0 ? static_cast<UInt>(frameBudget / tileMs) : FIRST_TILE_BATCH;
+	batch = std::max(1u, std::min(batch, tilesLeft));
+
+	// Edge tiles are smaller, the work is what's actually rendered
+	UInt pixels = 0;
+	for (UInt i = 0; i < batch; i++)
+	{
+		UInt tile = (nextTile + i) % tileCount;
+		pixels += std::min(TILE_SIZE, width - tile % tilesX * TILE_SIZE) * std::min(TILE_SIZE, height - tile / tilesX * TILE_SIZE);
+	}
+
+	gpuTimers.Begin(GpuSection::Fractal, std::max(1u, pixels / PIXELS_PER_WORK));
+
+	// Tiles left for later frames keep showing the last image
+	if (batch < tileCount && displayedOutput != 0 && displayedOutput != output)
+	{
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glCopyImageSubData(
+			displayedOutput, GL_TEXTURE_2D, 0, 0, 0, 0,
+			output, GL_TEXTURE_2D, 0, 0, 0, 0,
+			width, height, 1);
+	}
+
+	for (UInt i = 0; i < batch; i++)
+	{
+		UInt tile = nextTile;
+		nextTile = (nextTile + 1) % tileCount;
+
+		UInt x = tile % tilesX * TILE_SIZE;
+		UInt y = tile / tilesX * TILE_SIZE;
+		DispatchRegion(levelKernel, workQueue, width, height, x, y, std::min(TILE_SIZE, width - x), std::min(TILE_SIZE, height - y));
 	}
+
+	gpuTimers.End();
+
+	tilesLeft -= batch;
+	return tilesLeft == 0;
+}
+
+bool Game::Supersample()
+{
+	KernelConfig config = SupersampleKernel(levelKernel);
+
+	// Never waits for the compiler, the image is supersampled on a later frame instead
+	UInt job = QueueProgram(config);
+	if (!shaderCompiler.IsReady(job)) return false;
+
+	gpuTimers.Begin(GpuSection::Supersample);
+	glBindImageTexture(0, displayedOutput, 0, false, 0, GL_READ_ONLY, GL_R16UI);
+	glBindImageTexture(SAMPLE_INDEX_IMAGE_UNIT, sampleIndexTexture, 0, false, 0, GL_WRITE_ONLY, GL_R32UI);
+	glBindVertexArray(computeVAO);
+	glUseProgram(shaderCompiler.Get(job));
+	glUniform1i(0, 0); // Bind default texture
+	glUniform1i(1, level.iterationBudget);
+	SetViewUniforms(level.precision, renderedState.zoom, renderedState.offset);
+	DispatchSupersample(config, boundaryBuffer, boundaryCapacity, boundaryThreshold, viewSize[0], viewSize[1]);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+	gpuTimers.End();
+
+	supersampleValid = true;
+	return true;
+}
+
+bool Game::Accumulate()
+{
+	if (accumulatedFrames >= accumulateFrames) return false;
+
+	gpuTimers.Begin(GpuSection::Accumulate);
+
+	// The image itself is the first frame, with its supersampled boundaries. The rest are
+	// rendered again with the next jitter of the sequence, centred on the pixel.
+	UInt source = displayedOutput;
+
+	if (accumulatedFrames > 0)
+	{
+		glBindImageTexture(0, jitterOutput, 0, false, 0, GL_WRITE_ONLY, GL_R16UI);
+		glBindVertexArray(computeVAO);
+		glUseProgram(currentProgram);
+		glUniform1i(0, 0); // Bind default texture
+		glUniform1i(1, level.iterationBudget);
+		SetViewUniforms(level.precision, renderedState.zoom, renderedState.offset);
+		glUniform2f(11, Halton(accumulatedFrames, 2) - 0.5f, Halton(accumulatedFrames, 3) - 0.5f);
+		DispatchKernel(levelKernel, workQueue, viewSize[0], viewSize[1]);
+		glUniform2f(11, 0.f, 0.f);
+
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		source = jitterOutput;
+	}
+
+	// Flipped vertically so the accumulation's rows match the dwell's, it's drawn with the same quad
+	Matrix3 ortho(
+		2.f / viewSize[0], 0.f, -1.f,
+		0.f, -2.f / viewSize[1], 1.f,
+		0.f, 0.f, 1.f);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, accumulationFramebuffer);
+	glViewport(0, 0, viewSize[0], viewSize[1]);
+
+	// The first frame replaces whatever was accumulated before
+	if (accumulatedFrames > 0)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+
+	glActiveTexture(GL_TEXTURE0 + 0);
+	glBindTexture(GL_TEXTURE_2D, source);
+
+	glBindVertexArray(quadVAO);
+	glUseProgram(colorizeProgram);
+	glUniform1i(0, 0); // Bind default texture
+	glUniformMatrix3fv(1, 1, true, &ortho[0][0]);
+	glUniform4f(2, 1.f, 1.f, 1.f, 1.f);
+	SetColorizeUniforms(transitionProgress);
+	glUniform2i(15, viewSize[0], viewSize[1]);
+	glUniform1i(17, SAMPLE_INDEX_UNIT);
+	// The samples belong to the image, not the jittered frames
+	glUniform1i(18, supersampleValid && accumulatedFrames == 0);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+
+	glDisable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, presentedSize[0], presentedSize[1]);
+	gpuTimers.End();
+
+	accumulatedFrames++;
+	return true;
+}
+
+float Game::RenderScale(bool moving) const
+{
+	// Tiles already keep the frame within a budget, and a still camera gets the full image
+	if (resolutionTarget <= 0.f || frameBudget > 0.f || !moving) return 1.f;
+
+	double workMs = gpuTimers.GetMetrics().workMs[static_cast<UInt>(GpuSection::Fractal)];
+	if (workMs <= 0.0) return 1.f;
+
+	// Cost goes with the pixel count, so with the square of the scale
+	double fullMs = workMs * viewSize[0] * viewSize[1] / PIXELS_PER_WORK;
+	float scale = static_cast<float>(std::sqrt(resolutionTarget / fullMs));
+	return MyClamp(scale, MIN_RENDER_SCALE, 1.f);
 }
 
 void Game::LoadLevel()
 {
-	currentProgram = levels[currentLevel].program;
+	// Only the current and next level's records are ever touched, the rest of the pack stays on disk
+	ReadLevel(levelPack.GetLevel(currentLevel), level);
+
+	levelKernel = kernelConfig;
+	levelKernel.formula = level.formula;
+	levelKernel.precision = GpuPrecision(level.precision);
+
+	previewKernel = levelKernel;
+	previewKernel.layered = true;
+
+	// Blocks only if the background compiler hasn't finished these programs yet
+	currentProgram = shaderCompiler.Get(QueueProgram(levelKernel));
+	previewKernelProgram = shaderCompiler.Get(QueueProgram(previewKernel));
+	if (supersample) QueueProgram(SupersampleKernel(levelKernel));
 	for (UInt i = 0; i < 4; i++)
 	{
 		foundImages[i] = false;
@@ -708,50 +1236,229 @@ void Game::LoadLevel()
 
 void Game::GeneratePreviews()
 {
-	glBindVertexArray(computeVAO);
-	glUseProgram(levels[currentLevel].program);
+	Invalidate();
+	gpuTimers.Begin(GpuSection::Previews);
+
+	// Offset, size and whether to render, for every layer
+	double views[MAX_KERNEL_LAYERS][4] = {};
+	bool render = false;
 
 	for (UInt i = 0; i < 4; i++)
 	{
-		glUniform1i(0, i + 1); // Bind default texture
-		glUniform1i(1, 60); // more iterations
-		glUniform1f(2, levels[currentLevel].zooms[i]); // Use member zoom
-		glUniform2f(3, 
-			levels[currentLevel].offsets[i][0], 
-			levels[currentLevel].offsets[i][1]); // Use member offset
-		glDispatchCompute(previewSize[0], previewSize[1], 1); // Dispatch view size
-
 		foundImages[i] = false;
 		texColors[i] = Color(1.f, 1.f, 1.f, 1.f);
 
+		const AssetRef& asset = levelPack.GetLevel(currentLevel).previews[i];
+		const std::uint8_t* baked = levelPack.GetPreviewAsset(currentLevel, i);
+		previewBaked[i] = baked != nullptr;
+
+		if (baked)
+		{
+			UploadBakedPreview(BAKED_PREVIEW_UNIT + i, bakedPreviews[i], asset, baked);
+			continue;
+		}
+
+		views[i][0] = level.offsets[i].x;
+		views[i][1] = level.offsets[i].y;
+		views[i][2] = level.zooms[i];
+		views[i][3] = 1.0;
+		render = true;
+	}
+
+	if (render)
+	{
+		glBindVertexArray(computeVAO);
+		glUseProgram(previewKernelProgram);
+		glUniform1i(1, level.iterationBudget); // Previews always use the full budget
+		DispatchPreviews(previewKernel, workQueue, previewViewBuffer, previewArray, views, previewSize);
+	}
+
+	gpuTimers.End();
+}
+
+void Game::StartPrefetch()
+{
+	prefetch.active = currentLevel + 1 < levelPack.GetLevelCount();
+	if (!prefetch.active) return;
+
+	prefetch.level = currentLevel + 1;
+	prefetch.previews = 0;
+	prefetch.rows = 0;
+	ReadLevel(levelPack.GetLevel(prefetch.level), prefetch.data);
+
+	prefetch.kernel = kernelConfig;
+	prefetch.kernel.formula = prefetch.data.formula;
+	prefetch.kernel.precision = GpuPrecision(prefetch.data.precision);
+
+	prefetch.previewKernel = prefetch.kernel;
+	prefetch.previewKernel.layered = true;
+
+	// Compiled in the background, or only looked up if an earlier level used the same kernel
+	prefetch.programJob = QueueProgram(prefetch.kernel);
+	prefetch.previewProgramJob = QueueProgram(prefetch.previewKernel);
+	if (supersample) QueueProgram(SupersampleKernel(prefetch.kernel));
+
+	// Textures are kept from one prefetch to the next, as they trade places with the current level's
+	if (prefetch.output != 0) return;
+
+	glActiveTexture(GL_TEXTURE0 + PREFETCH_UNIT);
+
+	glGenTextures(1, &prefetch.output);
+	glBindTexture(GL_TEXTURE_2D, prefetch.output);
+	SetNearestClamp(GL_TEXTURE_2D);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, viewSize[0], viewSize[1], 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+
+	glGenTextures(1, &prefetch.previewArray);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, prefetch.previewArray);
+	SetNearestClamp(GL_TEXTURE_2D_ARRAY);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16UI, previewSize[0], previewSize[1], 4, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+
+	glGenTextures(4, prefetch.bakedPreviews);
+	for (UInt i = 0; i < 4; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, prefetch.bakedPreviews[i]);
+		SetNearestClamp(GL_TEXTURE_2D);
+	}
+}
+
+bool Game::PrefetchDone() const
+{
+	return prefetch.previews == 4 && prefetch.rows >= static_cast<UInt>(viewSize[1]);
+}
+
+bool Game::PrefetchSlice()
+{
+	if (!prefetch.active || PrefetchDone()) return false;
+
+	// Never waits for the compiler, the slice is tried again next frame
+	if (!shaderCompiler.IsReady(prefetch.programJob) || !shaderCompiler.IsReady(prefetch.previewProgramJob)) return false;
+
+	const Level& next = prefetch.data;
+	gpuTimers.Begin(GpuSection::Prefetch);
+	glBindVertexArray(computeVAO);
+
+	if (prefetch.previews < 4)
+	{
+		UInt slot = prefetch.previews++;
+
+		const AssetRef& asset = levelPack.GetLevel(prefetch.level).previews[slot];
+		const std::uint8_t* baked = levelPack.GetPreviewAsset(prefetch.level, slot);
+		prefetch.previewBaked[slot] = baked != nullptr;
+
+		if (baked)
+		{
+			UploadBakedPreview(PREFETCH_UNIT, prefetch.bakedPreviews[slot], asset, baked);
+		}
+		else
+		{
+			// One layer per slice, the others are flagged off
+			double views[MAX_KERNEL_LAYERS][4] = {};
+			views[slot][0] = next.offsets[slot].x;
+			views[slot][1] = next.offsets[slot].y;
+			views[slot][2] = next.zooms[slot];
+			views[slot][3] = 1.0;
+
+			glUseProgram(shaderCompiler.Get(prefetch.previewProgramJob));
+			glUniform1i(1, next.iterationBudget);
+			DispatchPreviews(prefetch.previewKernel, workQueue, previewViewBuffer, prefetch.previewArray, views, previewSize);
+		}
+	}
+	else
+	{
+		UInt width = viewSize[0];
+		UInt height = viewSize[1];
+		UInt rows = std::min(std::max(1u, PREFETCH_SLICE_PIXELS / width), height - prefetch.rows);
+
+		// Levels always start from the default view
+		glBindImageTexture(0, prefetch.output, 0, false, 0, GL_WRITE_ONLY, GL_R16UI);
+		glUseProgram(shaderCompiler.Get(prefetch.programJob));
+		glUniform1i(0, 0); // Bind default texture
+		glUniform1i(1, next.iterationBudget);
+		SetViewUniforms(next.precision, defaultZoom, WorldPoint());
+		DispatchRegion(prefetch.kernel, workQueue, width, height, 0, prefetch.rows, width, rows);
+
 		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		prefetch.rows += rows;
 	}
+
+	gpuTimers.End();
+	return true;
 }
 
-template <>
-GLSLFile* vlk::ConstructContent(const std::string& path)
+void Game::StartPrefetchedLevel()
 {
-	std::ifstream file(path);
-	std::cout << "Loading file: " << path << std::endl;
+	if (!prefetch.active || prefetch.level != currentLevel)
+	{
+		LoadLevel();
+		GeneratePreviews();
+		return;
+	}
 
-	// path parameter may not point to a valid file
-	if (!file.good()) return nullptr;
+	// Whatever is left is finished now, which is the old synchronous load at worst
+	shaderCompiler.Get(prefetch.programJob);
+	shaderCompiler.Get(prefetch.previewProgramJob);
+	while (PrefetchSlice()) { }
 
-	// Construct instance of MyContent
-	GLSLFile* content = new GLSLFile();
+	level = prefetch.data;
+	levelKernel = prefetch.kernel;
+	previewKernel = prefetch.previewKernel;
+	currentProgram = shaderCompiler.Get(prefetch.programJob);
+	previewKernelProgram = shaderCompiler.Get(prefetch.previewProgramJob);
 
-	// Read file contents into object
-	std::string temp;
-	while (std::getline(file, temp))
+	for (UInt i = 0; i < 4; i++)
 	{
-		content->data += (temp + "\n");
+		foundImages[i] = false;
+		texColors[i] = Color(1.f, 1.f, 1.f, 1.f);
+		previewBaked[i] = prefetch.previewBaked[i];
+
+		std::swap(bakedPreviews[i], prefetch.bakedPreviews[i]);
+		glActiveTexture(GL_TEXTURE0 + BAKED_PREVIEW_UNIT + i);
+		glBindTexture(GL_TEXTURE_2D, bakedPreviews[i]);
 	}
 
-	return content;
+	std::swap(previewArray, prefetch.previewArray);
+	glActiveTexture(GL_TEXTURE0 + PREVIEW_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, previewArray);
+
+	// The starting view takes the place of the output this frame would have rendered into
+	std::swap(fractalOutputs[frameIndex], prefetch.output);
+	displayedOutput = fractalOutputs[frameIndex];
+
+	renderedState.program = currentProgram;
+	renderedState.iterations = level.iterationBudget;
+	renderedState.zoom = defaultZoom;
+	renderedState.offset = WorldPoint();
+	renderedState.scale = 1.f;
+	displayedScale = 1.f;
+	// The jump back to the starting view isn't camera movement
+	requestedState = renderedState;
+	fractalValid = true;
+	supersampleValid = false;
+	accumulatedFrames = 0;
+	screenChanged = true;
+
+	prefetch.active = false;
+}
+
+void Game::EvictPrefetch()
+{
+	prefetch.active = false;
+
+	glDeleteTextures(1, &prefetch.output);
+	glDeleteTextures(1, &prefetch.previewArray);
+	glDeleteTextures(4, prefetch.bakedPreviews);
+
+	prefetch.output = 0;
+	prefetch.previewArray = 0;
+	for (UInt& texture : prefetch.bakedPreviews) texture = 0;
 }
 
-template <>
-void vlk::DestroyContent(GLSLFile* file)
+void Game::SetColorizeUniforms(float progress)
 {
-	delete file;
+	glUniform1i(3, PALETTE_UNIT);
+	glUniform1f(4, paletteOffset);
+	glUniform1f(5, palettePeriod);
+	glUniform1i(6, static_cast<Int>(transition));
+	glUniform1f(7, progress);
+	glUniform1f(8, static_cast<float>(level.iterationBudget));
 }
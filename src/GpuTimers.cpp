@@ -0,0 +1,166 @@
+#include "GpuTimers.hpp"
+
+#include "glad/glad.h"
+
+using namespace game;
+
+namespace
+{
+	const char* const SECTION_NAMES[] =
+	{
+		"fractal",
+		"previews",
+		"present",
+		"prefetch",
+		"supersample",
+		"accumulate",
+	};
+
+	static_assert(sizeof(SECTION_NAMES) / sizeof(SECTION_NAMES[0]) == static_cast<std::size_t>(GpuSection::Count), "GPU section name table out of date");
+
+	// Weight of the newest sample in the moving averages
+	constexpr double SMOOTHING = 0.05;
+
+	void Accumulate(double& average, double sample, UInt frames)
+	{
+		average = frames == 0 ? sample : average + (sample - average) * SMOOTHING;
+	}
+
+	double QueryMilliseconds(UInt query)
+	{
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		return static_cast<double>(nanoseconds) * 1e-6;
+	}
+}
+
+const char* game::GpuSectionName(GpuSection section)
+{
+	return section < GpuSection::Count ? SECTION_NAMES[static_cast<std::size_t>(section)] : "unknown";
+}
+
+GpuTimers::GpuTimers() :
+	frames {},
+	current(0),
+	sectionSamples {},
+	workSamples {},
+	frameOpen(false),
+	sectionOpen(false)
+{
+
+}
+
+GpuTimers::~GpuTimers()
+{
+	for (Frame& frame : frames)
+	{
+		if (frame.begin == 0) continue;
+
+		glDeleteQueries(SECTION_COUNT, frame.sections);
+		glDeleteQueries(1, &frame.begin);
+		glDeleteQueries(1, &frame.end);
+	}
+}
+
+void GpuTimers::Init()
+{
+	for (Frame& frame : frames)
+	{
+		glGenQueries(SECTION_COUNT, frame.sections);
+		glGenQueries(1, &frame.begin);
+		glGenQueries(1, &frame.end);
+	}
+}
+
+void GpuTimers::BeginFrame()
+{
+	if (frameOpen || frames[current].begin == 0) return;
+
+	Frame& frame = frames[current];
+	if (frame.pending) Collect(frame);
+
+	glQueryCounter(frame.begin, GL_TIMESTAMP);
+	frameOpen = true;
+}
+
+void GpuTimers::EndFrame()
+{
+	if (!frameOpen) return;
+
+	End();
+
+	Frame& frame = frames[current];
+	glQueryCounter(frame.end, GL_TIMESTAMP);
+	frame.pending = true;
+	frameOpen = false;
+
+	current = (current + 1) % FRAMES_IN_FLIGHT;
+}
+
+void GpuTimers::Begin(GpuSection section, UInt work)
+{
+	// Work outside a frame, like previews rendered while loading a level, goes into the next one
+	if (!frameOpen) BeginFrame();
+	if (!frameOpen || sectionOpen) return;
+
+	Frame& frame = frames[current];
+	UInt index = static_cast<UInt>(section);
+	if (frame.used[index]) return;
+
+	glBeginQuery(GL_TIME_ELAPSED, frame.sections[index]);
+	frame.used[index] = true;
+	frame.work[index] = work;
+	sectionOpen = true;
+}
+
+void GpuTimers::End()
+{
+	if (!sectionOpen) return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	sectionOpen = false;
+}
+
+void GpuTimers::Collect(Frame& frame)
+{
+	frame.pending = false;
+
+	// The end timestamp is the last query of the frame, once it's ready all of them are
+	GLint available = 0;
+	glGetQueryObjectiv(frame.end, GL_QUERY_RESULT_AVAILABLE, &available);
+
+	if (!available)
+	{
+		metrics.dropped++;
+	}
+	else
+	{
+		// Sections that don't run every frame, like previews, average over the frames they ran in
+		for (UInt i = 0; i < SECTION_COUNT; i++)
+		{
+			if (!frame.used[i]) continue;
+
+			double ms = QueryMilliseconds(frame.sections[i]);
+			Accumulate(metrics.sectionMs[i], ms, sectionSamples[i]);
+			sectionSamples[i]++;
+
+			if (frame.work[i] == 0) continue;
+
+			Accumulate(metrics.workMs[i], ms / frame.work[i], workSamples[i]);
+			workSamples[i]++;
+		}
+
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(frame.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.end, GL_QUERY_RESULT, &end);
+		Accumulate(metrics.frameMs, static_cast<double>(end - begin) * 1e-6, metrics.frames);
+
+		metrics.frames++;
+	}
+
+	for (UInt i = 0; i < SECTION_COUNT; i++)
+	{
+		frame.used[i] = false;
+	}
+}
@@ -0,0 +1,142 @@
+#include "InputLog.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace game;
+
+namespace
+{
+	constexpr std::uint8_t FIELD_SCROLL = 1 << 0;
+	constexpr std::uint8_t FIELD_MOUSE_DELTA = 1 << 1;
+	constexpr std::uint8_t FIELD_MOUSE_POS = 1 << 2;
+	constexpr std::uint8_t FIELD_BUTTONS = 1 << 3;
+	constexpr std::uint8_t FIELD_KEYS = 1 << 4;
+
+	void WriteVarint(std::ofstream& file, std::uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			file.put(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+
+		file.put(static_cast<char>(value));
+	}
+
+	bool ReadVarint(std::ifstream& file, std::uint32_t& value)
+	{
+		value = 0;
+
+		for (std::uint32_t shift = 0; shift < 35; shift += 7)
+		{
+			int byte = file.get();
+			if (byte == EOF) return false;
+
+			value |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) return true;
+		}
+
+		return false;
+	}
+
+	template <class T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template <class T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+}
+
+void InputRecorder::Open(const std::string& path, std::uint32_t viewWidth, std::uint32_t viewHeight)
+{
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+		throw std::runtime_error("Failed to open input log for writing: " + path);
+	}
+
+	InputLogHeader header {};
+	std::memcpy(header.magic, INPUT_LOG_MAGIC, sizeof(header.magic));
+	header.version = INPUT_LOG_VERSION;
+	header.viewWidth = viewWidth;
+	header.viewHeight = viewHeight;
+	WriteValue(file, header);
+}
+
+void InputRecorder::Record(const InputFrame& frame)
+{
+	if (!file.is_open()) return;
+
+	std::uint8_t mask = 0;
+	if (frame.scroll != 0.f) mask |= FIELD_SCROLL;
+	if (frame.mouseDelta[0] != 0.f || frame.mouseDelta[1] != 0.f) mask |= FIELD_MOUSE_DELTA;
+	if (frame.buttons != 0) mask |= FIELD_BUTTONS;
+	if (frame.keys != 0) mask |= FIELD_KEYS;
+
+	// The cursor position is only read on a click
+	if (frame.buttons & InputButtons::LeftPressed) mask |= FIELD_MOUSE_POS;
+
+	file.put(static_cast<char>(mask));
+	WriteVarint(file, frame.frameMicros);
+
+	if (mask & FIELD_SCROLL) WriteValue(file, frame.scroll);
+	if (mask & FIELD_MOUSE_DELTA) WriteValue(file, frame.mouseDelta);
+	if (mask & FIELD_MOUSE_POS) WriteValue(file, frame.mousePos);
+	if (mask & FIELD_BUTTONS) WriteValue(file, frame.buttons);
+	if (mask & FIELD_KEYS) WriteValue(file, frame.keys);
+}
+
+void InputRecorder::Close()
+{
+	if (file.is_open()) file.close();
+}
+
+void InputReplay::Open(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.good())
+	{
+		throw std::runtime_error("Failed to open input log: " + path);
+	}
+
+	if (!ReadValue(file, header) ||
+		std::memcmp(header.magic, INPUT_LOG_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != INPUT_LOG_VERSION)
+	{
+		throw std::runtime_error("Not a valid input log: " + path);
+	}
+
+	frames.clear();
+	position = 0;
+
+	for (int mask = file.get(); mask != EOF; mask = file.get())
+	{
+		InputFrame frame;
+		bool ok = ReadVarint(file, frame.frameMicros);
+
+		if (ok && (mask & FIELD_SCROLL)) ok = ReadValue(file, frame.scroll);
+		if (ok && (mask & FIELD_MOUSE_DELTA)) ok = ReadValue(file, frame.mouseDelta);
+		if (ok && (mask & FIELD_MOUSE_POS)) ok = ReadValue(file, frame.mousePos);
+		if (ok && (mask & FIELD_BUTTONS)) ok = ReadValue(file, frame.buttons);
+		if (ok && (mask & FIELD_KEYS)) ok = ReadValue(file, frame.keys);
+
+		// A log cut short by a crash still replays up to its last whole frame
+		if (!ok) break;
+
+		frames.push_back(frame);
+	}
+}
+
+bool InputReplay::Next(InputFrame& frame)
+{
+	if (position >= frames.size()) return false;
+
+	frame = frames[position++];
+	return true;
+}
@@ -0,0 +1,336 @@
+#include "LevelPack.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace game;
+
+namespace
+{
+	constexpr std::uint64_t ALIGNMENT = 8;
+
+	constexpr std::uint64_t Align(std::uint64_t value)
+	{
+		return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	const char* const FORMULA_NAMES[] =
+	{
+		"mandelbrot",
+		"tricorn",
+		"burning",
+		"julia0",
+		"julia1",
+		"julia2",
+		"multibrot3",
+		"multibrot4",
+		"multibrot5",
+		"multibrot6",
+		"multibrot7",
+		"multibrot8",
+		"multicorn3",
+		"multicorn4",
+		"multicorn5",
+		"multicorn6",
+		"multicorn7",
+		"multicorn8",
+	};
+
+	const char* const PRECISION_NAMES[] =
+	{
+		"float",
+		"double",
+		"dd",
+		"perturbation",
+	};
+
+	static_assert(sizeof(FORMULA_NAMES) / sizeof(FORMULA_NAMES[0]) == static_cast<std::size_t>(Formula::Count),
+		"Formula name table out of date");
+	static_assert(sizeof(PRECISION_NAMES) / sizeof(PRECISION_NAMES[0]) == static_cast<std::size_t>(PrecisionTier::Count),
+		"Precision tier name table out of date");
+}
+
+LevelPack::LevelPack() :
+	data(nullptr),
+	size(0),
+	mapping(nullptr)
+{ }
+
+LevelPack::~LevelPack()
+{
+	Close();
+}
+
+bool LevelPack::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (map == nullptr) return false;
+
+	void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(map);
+		return false;
+	}
+
+	mapping = map;
+	data = static_cast<const std::uint8_t*>(view);
+	size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED) return false;
+
+	// Levels are visited one at a time, don't read ahead the whole pack
+	madvise(view, static_cast<std::size_t>(st.st_size), MADV_RANDOM);
+
+	data = static_cast<const std::uint8_t*>(view);
+	size = static_cast<std::size_t>(st.st_size);
+#endif
+
+	// Only the header and the bounds of the index are checked up front,
+	// records are validated as they are requested.
+	const LevelPackHeader* header = Header();
+	if (size < sizeof(LevelPackHeader) ||
+		std::memcmp(header->magic, LEVEL_PACK_MAGIC, sizeof(LEVEL_PACK_MAGIC)) != 0 ||
+		header->version != LEVEL_PACK_VERSION ||
+		header->headerSize != sizeof(LevelPackHeader) ||
+		header->fileSize != size ||
+		header->indexOffset % ALIGNMENT != 0 ||
+		header->indexOffset > size ||
+		(size - header->indexOffset) / sizeof(LevelIndexEntry) < header->levelCount)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void LevelPack::Close()
+{
+	if (data == nullptr) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(static_cast<HANDLE>(mapping));
+#else
+	munmap(const_cast<std::uint8_t*>(data), size);
+#endif
+
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+}
+
+const LevelPackHeader* LevelPack::Header() const
+{
+	return reinterpret_cast<const LevelPackHeader*>(data);
+}
+
+std::uint32_t LevelPack::GetLevelCount() const
+{
+	if (data == nullptr) return 0;
+	return Header()->levelCount;
+}
+
+const LevelRecord& LevelPack::GetLevel(std::uint32_t index) const
+{
+	if (index >= GetLevelCount())
+	{
+		throw std::out_of_range("Level index out of range: " + std::to_string(index));
+	}
+
+	const LevelIndexEntry* entry = reinterpret_cast<const LevelIndexEntry*>(data + Header()->indexOffset) + index;
+
+	if (entry->recordOffset % ALIGNMENT != 0 ||
+		entry->recordSize < sizeof(LevelRecord) ||
+		entry->recordOffset > size ||
+		size - entry->recordOffset < entry->recordSize)
+	{
+		throw std::runtime_error("Corrupt level record: " + std::to_string(index));
+	}
+
+	const LevelRecord* record = reinterpret_cast<const LevelRecord*>(data + entry->recordOffset);
+
+	if (record->formula >= Formula::Count || record->precision >= PrecisionTier::Count)
+	{
+		throw std::runtime_error("Unsupported level record: " + std::to_string(index));
+	}
+
+	for (const AssetRef& asset : record->previews)
+	{
+		if (asset.format != AssetFormat::None &&
+			(asset.offset > size || size - asset.offset < asset.size))
+		{
+			throw std::runtime_error("Corrupt level asset: " + std::to_string(index));
+		}
+	}
+
+	return *record;
+}
+
+const std::uint8_t* LevelPack::GetPreviewAsset(std::uint32_t index, std::uint32_t slot) const
+{
+	const AssetRef& asset = GetLevel(index).previews[slot];
+
+	switch (asset.format)
+	{
+		case AssetFormat::RGBA8:
+			// In 64 bits, so a corrupt size can't wrap around to match
+			if (asset.size != static_cast<std::uint64_t>(asset.width) * asset.height * 4) return nullptr;
+			return data + asset.offset;
+		default:
+			return nullptr;
+	}
+}
+
+void game::WriteLevelPack(const std::string& path, const std::vector<LevelDesc>& levels)
+{
+	LevelPackHeader header {};
+	std::memcpy(header.magic, LEVEL_PACK_MAGIC, sizeof(LEVEL_PACK_MAGIC));
+	header.version = LEVEL_PACK_VERSION;
+	header.headerSize = sizeof(LevelPackHeader);
+	header.levelCount = static_cast<std::uint32_t>(levels.size());
+	header.indexOffset = Align(sizeof(LevelPackHeader));
+
+	std::vector<LevelIndexEntry> index(levels.size());
+	std::vector<LevelRecord> records(levels.size());
+
+	// Records follow the index, assets follow the records
+	std::uint64_t offset = Align(header.indexOffset + sizeof(LevelIndexEntry) * levels.size());
+
+	for (std::size_t i = 0; i < levels.size(); i++)
+	{
+		index[i].recordOffset = offset;
+		index[i].recordSize = sizeof(LevelRecord);
+		offset = Align(offset + sizeof(LevelRecord));
+	}
+
+	for (std::size_t i = 0; i < levels.size(); i++)
+	{
+		records[i] = levels[i].record;
+
+		for (std::uint32_t j = 0; j < 4; j++)
+		{
+			AssetRef& asset = records[i].previews[j];
+
+			if (levels[i].previews[j].empty())
+			{
+				asset = AssetRef {};
+				continue;
+			}
+
+			asset.offset = offset;
+			asset.size = static_cast<std::uint32_t>(levels[i].previews[j].size());
+			offset = Align(offset + asset.size);
+		}
+	}
+
+	header.fileSize = offset;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+		throw std::runtime_error("Failed to open level pack for writing: " + path);
+	}
+
+	auto pad = [&file]()
+	{
+		static const char zeros[ALIGNMENT] {};
+		std::uint64_t position = static_cast<std::uint64_t>(file.tellp());
+		file.write(zeros, static_cast<std::streamsize>(Align(position) - position));
+	};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pad();
+	file.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(sizeof(LevelIndexEntry) * index.size()));
+	pad();
+
+	for (const LevelRecord& record : records)
+	{
+		file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+		pad();
+	}
+
+	for (const LevelDesc& level : levels)
+	{
+		for (const auto& preview : level.previews)
+		{
+			if (preview.empty()) continue;
+			file.write(reinterpret_cast<const char*>(preview.data()), static_cast<std::streamsize>(preview.size()));
+			pad();
+		}
+	}
+
+	if (!file.good())
+	{
+		throw std::runtime_error("Failed to write level pack: " + path);
+	}
+}
+
+Formula game::ParseFormula(const std::string& name)
+{
+	for (std::size_t i = 0; i < static_cast<std::size_t>(Formula::Count); i++)
+	{
+		if (name == FORMULA_NAMES[i]) return static_cast<Formula>(i);
+	}
+
+	throw std::runtime_error("Unknown formula: " + name);
+}
+
+PrecisionTier game::ParsePrecisionTier(const std::string& name)
+{
+	for (std::size_t i = 0; i < static_cast<std::size_t>(PrecisionTier::Count); i++)
+	{
+		if (name == PRECISION_NAMES[i]) return static_cast<PrecisionTier>(i);
+	}
+
+	throw std::runtime_error("Unknown precision tier: " + name);
+}
+
+const char* game::FormulaName(Formula formula)
+{
+	return formula < Formula::Count ? FORMULA_NAMES[static_cast<std::size_t>(formula)] : "unknown";
+}
+
+const char* game::PrecisionTierName(PrecisionTier tier)
+{
+	return tier < PrecisionTier::Count ? PRECISION_NAMES[static_cast<std::size_t>(tier)] : "unknown";
+}
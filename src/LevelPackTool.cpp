@@ -0,0 +1,140 @@
+#include "LevelPack.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace game;
+
+// Compiles a plain text level list into a binary level pack:
+//
+//   level <formula> <precision> <iterations>
+//   target <zoom> <x> <y> [preview.png]
+//
+// Each level is followed by exactly four targets. Preview images are optional, they are
+// baked into the pack as RGBA8 and shown instead of rendering the preview at runtime.
+
+std::vector<std::uint8_t> LoadPreview(const std::string& path, AssetRef& asset)
+{
+	int width, height;
+	unsigned char* pixels = stbi_load(path.c_str(), &width, &height, nullptr, 4);
+
+	if (pixels == nullptr)
+	{
+		throw std::runtime_error("Failed to load preview image: " + path);
+	}
+
+	std::vector<std::uint8_t> result(pixels, pixels + width * height * 4);
+	stbi_image_free(pixels);
+
+	asset.format = AssetFormat::RGBA8;
+	asset.width = static_cast<std::uint32_t>(width);
+	asset.height = static_cast<std::uint32_t>(height);
+	return result;
+}
+
+std::vector<LevelDesc> ParseLevels(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.good())
+	{
+		throw std::runtime_error("Failed to open level list: " + path);
+	}
+
+	std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+	std::vector<LevelDesc> levels;
+	std::uint32_t numTargets = 4;
+	std::uint32_t lineNumber = 0;
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		std::istringstream stream(line);
+		std::string command;
+		if (!(stream >> command) || command[0] == '#') continue;
+
+		auto error = [&](const std::string& message)
+		{
+			return std::runtime_error(path + ":" + std::to_string(lineNumber) + ": " + message);
+		};
+
+		if (command == "level")
+		{
+			if (numTargets != 4) throw error("previous level has " + std::to_string(numTargets) + " targets, expected 4");
+
+			std::string formula, precision;
+			LevelDesc level {};
+			if (!(stream >> formula >> precision >> level.record.iterationBudget)) throw error("expected: level <formula> <precision> <iterations>");
+
+			if (level.record.iterationBudget == 0 || level.record.iterationBudget > MAX_ITERATION_BUDGET)
+			{
+				throw error("iterations must be between 1 and " + std::to_string(MAX_ITERATION_BUDGET));
+			}
+
+			level.record.formula = ParseFormula(formula);
+			level.record.precision = ParsePrecisionTier(precision);
+			levels.push_back(level);
+			numTargets = 0;
+		}
+		else if (command == "target")
+		{
+			if (levels.empty() || numTargets == 4) throw error("target without a level");
+
+			LevelDesc& level = levels.back();
+			if (!(stream >> level.record.zooms[numTargets] >>
+				level.record.offsets[numTargets][0] >>
+				level.record.offsets[numTargets][1]))
+			{
+				throw error("expected: target <zoom> <x> <y> [preview.png]");
+			}
+
+			std::string preview;
+			if (stream >> preview)
+			{
+				level.previews[numTargets] = LoadPreview(directory + preview, level.record.previews[numTargets]);
+			}
+
+			numTargets++;
+		}
+		else
+		{
+			throw error("unknown command: " + command);
+		}
+	}
+
+	if (numTargets != 4)
+	{
+		throw std::runtime_error(path + ": last level has " + std::to_string(numTargets) + " targets, expected 4");
+	}
+
+	return levels;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cout << "Usage: " << argv[0] << " <levels.txt> <output.pack>" << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		std::vector<LevelDesc> levels = ParseLevels(argv[1]);
+		WriteLevelPack(argv[2], levels);
+		std::cout << "Wrote " << levels.size() << " levels to " << argv[2] << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
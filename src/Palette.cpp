@@ -0,0 +1,126 @@
+#include "Palette.hpp"
+
+#include "glad/glad.h"
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace game;
+
+namespace
+{
+	// Texels per repeat, enough that linear filtering between them is invisible
+	constexpr UInt PALETTE_SIZE = 256;
+
+	const char* const PALETTE_NAMES[] =
+	{
+		"hue",
+		"fire",
+		"ocean",
+		"grayscale",
+	};
+
+	static_assert(sizeof(PALETTE_NAMES) / sizeof(PALETTE_NAMES[0]) == static_cast<std::size_t>(Palette::Count), "Palette name table out of date");
+
+	struct Stop
+	{
+		float position;
+		float color[3];
+	};
+
+	// Stops are in increasing position, the last one blends back into the first
+	std::vector<Stop> GetStops(Palette palette)
+	{
+		switch (palette)
+		{
+			case Palette::Fire:
+				return {
+					{ 0.f, { 0.f, 0.f, 0.f } },
+					{ 0.3f, { 0.7f, 0.05f, 0.f } },
+					{ 0.55f, { 1.f, 0.45f, 0.f } },
+					{ 0.8f, { 1.f, 0.9f, 0.35f } },
+					{ 0.9f, { 1.f, 1.f, 0.9f } },
+				};
+
+			case Palette::Ocean:
+				return {
+					{ 0.f, { 0.f, 0.03f, 0.15f } },
+					{ 0.35f, { 0.f, 0.3f, 0.6f } },
+					{ 0.6f, { 0.2f, 0.75f, 0.85f } },
+					{ 0.8f, { 0.9f, 1.f, 1.f } },
+				};
+
+			case Palette::Grayscale:
+				return {
+					{ 0.f, { 0.1f, 0.1f, 0.1f } },
+					{ 0.5f, { 1.f, 1.f, 1.f } },
+				};
+
+			// Same colours the kernels used to compute with HueToRGB
+			default:
+				return {
+					{ 0.f / 6.f, { 1.f, 0.f, 0.f } },
+					{ 1.f / 6.f, { 1.f, 1.f, 0.f } },
+					{ 2.f / 6.f, { 0.f, 1.f, 0.f } },
+					{ 3.f / 6.f, { 0.f, 1.f, 1.f } },
+					{ 4.f / 6.f, { 0.f, 0.f, 1.f } },
+					{ 5.f / 6.f, { 1.f, 0.f, 1.f } },
+				};
+		}
+	}
+}
+
+Palette game::ParsePalette(const std::string& name)
+{
+	for (std::size_t i = 0; i < static_cast<std::size_t>(Palette::Count); i++)
+	{
+		if (name == PALETTE_NAMES[i]) return static_cast<Palette>(i);
+	}
+
+	throw std::runtime_error("Unknown palette: " + name);
+}
+
+const char* game::PaletteName(Palette palette)
+{
+	return palette < Palette::Count ? PALETTE_NAMES[static_cast<std::size_t>(palette)] : "unknown";
+}
+
+UInt game::CreatePaletteTexture(Palette palette)
+{
+	std::vector<Stop> stops = GetStops(palette);
+	std::vector<std::uint8_t> texels(PALETTE_SIZE * 4);
+
+	for (UInt i = 0; i < PALETTE_SIZE; i++)
+	{
+		// Texel centres, so the filtered texture passes through every stop
+		float t = (i + 0.5f) / PALETTE_SIZE;
+
+		std::size_t next = 0;
+		while (next < stops.size() && stops[next].position <= t) next++;
+
+		const Stop& a = stops[(next + stops.size() - 1) % stops.size()];
+		const Stop& b = stops[next % stops.size()];
+
+		float start = a.position;
+		float end = next == stops.size() ? b.position + 1.f : b.position;
+		float blend = (t - start) / (end - start);
+
+		for (UInt c = 0; c < 3; c++)
+		{
+			float value = a.color[c] + (b.color[c] - a.color[c]) * blend;
+			texels[i * 4 + c] = static_cast<std::uint8_t>(std::lround(value * 255.f));
+		}
+
+		texels[i * 4 + 3] = 255;
+	}
+
+	UInt texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_1D, texture);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, PALETTE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	return texture;
+}
@@ -0,0 +1,376 @@
+#include "Shader.hpp"
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace game;
+
+namespace
+{
+	constexpr UInt MAX_INCLUDE_DEPTH = 16;
+
+	const char* const DISPATCH_MODE_NAMES[] =
+	{
+		"grid",
+		"two-pass",
+		"persistent",
+	};
+
+	static_assert(sizeof(DISPATCH_MODE_NAMES) / sizeof(DISPATCH_MODE_NAMES[0]) == static_cast<std::size_t>(DispatchMode::Count), "Dispatch mode name table out of date");
+
+	void CheckProgramError(UInt program)
+	{
+		Int success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (success == GL_FALSE)
+		{
+			Int logLength = 0;
+			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+			char* infoLog = new char[logLength];
+			glGetProgramInfoLog(program, logLength, &logLength, infoLog);
+			std::cout << "Failed to compile shader program:\n" << infoLog << std::endl;
+			delete[] infoLog;
+			throw std::runtime_error("Failed to compile shader program.");
+		}
+	}
+
+	void CheckShaderError(UInt shader)
+	{
+		Int success = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (success == GL_FALSE)
+		{
+			Int logLength = 0;
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+			char* infoLog = new char[logLength];
+			glGetShaderInfoLog(shader, logLength, &logLength, infoLog);
+			std::cout << "Failed to compile shader:\n" << infoLog << std::endl;
+			delete[] infoLog;
+			throw std::runtime_error("Failed to compile shader.");
+		}
+	}
+
+	// Defines have to go after #version, which must be the first directive in the source
+	std::string Specialize(const std::string& source, const std::string& defines)
+	{
+		if (defines.empty()) return source;
+
+		std::size_t version = source.find("#version");
+		std::size_t insert = version == std::string::npos ? 0 : source.find('\n', version);
+		insert = insert == std::string::npos ? source.size() : insert + 1;
+
+		return source.substr(0, insert) + defines + source.substr(insert);
+	}
+
+	// Owns a compiled shader object so it's deleted even if a later stage or the link throws
+	struct CompiledShader
+	{
+		UInt shader;
+
+		CompiledShader(const std::string& source, UInt usage) :
+			shader(glCreateShader(usage))
+		{
+			auto cstr = source.c_str();
+			glShaderSource(shader, 1, &cstr, nullptr);
+			glCompileShader(shader);
+
+			try
+			{
+				CheckShaderError(shader);
+			}
+			catch (...)
+			{
+				glDeleteShader(shader);
+				throw;
+			}
+		}
+
+		~CompiledShader()
+		{
+			glDeleteShader(shader);
+		}
+
+		CompiledShader(const CompiledShader&) = delete;
+		CompiledShader& operator=(const CompiledShader&) = delete;
+	};
+
+	UInt LinkProgram(std::initializer_list<UInt> shaders)
+	{
+		UInt program = glCreateProgram();
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+		for (UInt shader : shaders)
+		{
+			glAttachShader(program, shader);
+		}
+
+		glLinkProgram(program);
+
+		for (UInt shader : shaders)
+		{
+			glDetachShader(program, shader);
+		}
+
+		try
+		{
+			CheckProgramError(program);
+		}
+		catch (...)
+		{
+			glDeleteProgram(program);
+			throw;
+		}
+
+		return program;
+	}
+
+	// Reads a file, splicing in the contents of any #include "file" lines relative to it
+	bool ReadGLSL(const std::string& path, std::string& out, UInt depth)
+	{
+		std::ifstream file(path);
+		std::cout << "Loading file: " << path << std::endl;
+
+		// path parameter may not point to a valid file
+		if (!file.good()) return false;
+
+		if (depth > MAX_INCLUDE_DEPTH)
+		{
+			std::cout << "Include depth exceeded, circular include? " << path << std::endl;
+			return false;
+		}
+
+		std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+		std::string temp;
+
+		while (std::getline(file, temp))
+		{
+			std::size_t directive = temp.find_first_not_of(" \t");
+
+			if (directive != std::string::npos && temp.compare(directive, 8, "#include") == 0)
+			{
+				std::size_t open = temp.find('"', directive);
+				std::size_t close = open == std::string::npos ? open : temp.find('"', open + 1);
+
+				if (close == std::string::npos)
+				{
+					std::cout << "Malformed include in " << path << ": " << temp << std::endl;
+					return false;
+				}
+
+				if (!ReadGLSL(directory + temp.substr(open + 1, close - open - 1), out, depth + 1))
+				{
+					return false;
+				}
+
+				continue;
+			}
+
+			out += (temp + "\n");
+		}
+
+		return true;
+	}
+}
+
+std::string KernelConfig::Defines() const
+{
+	std::ostringstream defines;
+	defines << "#define FORMULA " << static_cast<UInt>(formula) << "\n";
+	defines << "#define PRECISION " << static_cast<UInt>(GpuPrecision(precision)) << "\n";
+	defines << "#define WORKGROUP_SIZE_X " << workgroupSizeX << "\n";
+	defines << "#define WORKGROUP_SIZE_Y " << workgroupSizeY << "\n";
+	defines << "#define ILP_FACTOR " << ilpFactor << "\n";
+	// Layered kernels are always grid dispatches
+	defines << "#define DISPATCH_MODE " << static_cast<UInt>(layered ? DispatchMode::Grid : dispatchMode) << "\n";
+	defines << "#define FIRST_PASS_ITERATIONS " << firstPassIterations << "\n";
+	defines << "#define BAILOUT " << std::showpoint << bailout << "\n";
+	defines << "#define MAX_LAYERS " << MAX_KERNEL_LAYERS << "\n";
+	if (layered) defines << "#define LAYERED\n";
+	if (supersample) defines << "#define SUPERSAMPLES " << SUPERSAMPLES << "\n";
+	return defines.str();
+}
+
+void KernelConfig::SetWorkgroupSize(const std::string& size)
+{
+	std::istringstream stream(size);
+	char separator = 0;
+
+	if (!(stream >> workgroupSizeX >> separator >> workgroupSizeY) || separator != 'x' ||
+		workgroupSizeX == 0 || workgroupSizeY == 0)
+	{
+		throw std::runtime_error("Invalid workgroup size: " + size);
+	}
+}
+
+void game::DispatchKernel(const KernelConfig& config, WorkQueue& queue, UInt width, UInt height, UInt layers)
+{
+	DispatchRegion(config, queue, width, height, 0, 0, width, height, layers);
+}
+
+// Most groups an indirect dispatch may launch along x, the kernels loop over anything past it
+UInt MaxGroupCount()
+{
+	static Int count = 0;
+	if (count == 0) glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &count);
+	return static_cast<UInt>(count);
+}
+
+void game::DispatchRegion(const KernelConfig& config, WorkQueue& queue, UInt width, UInt height, UInt x, UInt y, UInt regionWidth, UInt regionHeight, UInt layers)
+{
+	UInt pixelsX = config.workgroupSizeX * config.ilpFactor;
+	UInt pixelsY = config.workgroupSizeY;
+	UInt groupsX = (regionWidth + pixelsX - 1) / pixelsX;
+	UInt groupsY = (regionHeight + pixelsY - 1) / pixelsY;
+
+	glUniform2i(4, static_cast<Int>(width), static_cast<Int>(height));
+	glUniform2i(6, static_cast<Int>(x), static_cast<Int>(y));
+	glUniform2i(7, static_cast<Int>(regionWidth), static_cast<Int>(regionHeight));
+
+	if (config.dispatchMode == DispatchMode::Grid || config.layered)
+	{
+		glDispatchCompute(groupsX, groupsY, config.layered ? layers : 1);
+		return;
+	}
+
+	if (config.dispatchMode == DispatchMode::Persistent)
+	{
+		// Only the header is used, as the next tile counter
+		queue.Reserve(0, config.precision);
+		queue.Clear();
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, queue.GetBuffer());
+		glDispatchCompute(std::max(1u, std::min(config.persistentGroups, groupsX * groupsY)), 1, 1);
+		return;
+	}
+
+	queue.Reserve(regionWidth * regionHeight, config.precision);
+	queue.Clear();
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, queue.GetBuffer());
+	glUniform1i(5, 0);
+	glUniform1ui(12, MaxGroupCount());
+	glDispatchCompute(groupsX, groupsY, 1);
+
+	// The second pass reads the queue and takes its size from the header
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, queue.GetBuffer());
+	glUniform1i(5, 1);
+	glDispatchComputeIndirect(0);
+}
+
+std::size_t game::BoundaryBufferSize(UInt capacity)
+{
+	// The header, then BoundaryPixel in fractal.glsl: the pixel and two samples per word
+	return 16 + (8 + SUPERSAMPLES * 2) * static_cast<std::size_t>(capacity);
+}
+
+void game::DispatchSupersample(const KernelConfig& config, UInt boundaryBuffer, UInt capacity, Int threshold, UInt width, UInt height)
+{
+	const GLuint header[] = { 0, 1, 1, 0 };
+
+	// The last sampling pass may still be reading the header
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundaryBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, boundaryBuffer);
+
+	glUniform2i(4, static_cast<Int>(width), static_cast<Int>(height));
+	glUniform1i(8, threshold);
+	glUniform1ui(9, capacity);
+	glUniform1ui(12, MaxGroupCount());
+
+	// One pixel per invocation finds the boundary, one boundary pixel per invocation samples it
+	glUniform1i(5, 0);
+	glDispatchCompute((width + config.workgroupSizeX - 1) / config.workgroupSizeX, (height + config.workgroupSizeY - 1) / config.workgroupSizeY, 1);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, boundaryBuffer);
+	glUniform1i(5, 1);
+	glDispatchComputeIndirect(0);
+}
+
+DispatchMode game::ParseDispatchMode(const std::string& name)
+{
+	for (std::size_t i = 0; i < static_cast<std::size_t>(DispatchMode::Count); i++)
+	{
+		if (name == DISPATCH_MODE_NAMES[i]) return static_cast<DispatchMode>(i);
+	}
+
+	throw std::runtime_error("Unknown dispatch mode: " + name);
+}
+
+const char* game::DispatchModeName(DispatchMode mode)
+{
+	return mode < DispatchMode::Count ? DISPATCH_MODE_NAMES[static_cast<std::size_t>(mode)] : "unknown";
+}
+
+PrecisionTier game::GpuPrecision(PrecisionTier tier)
+{
+	return tier == PrecisionTier::Float ? PrecisionTier::Float : PrecisionTier::Double;
+}
+
+void game::LoadShader(const std::string& path, const std::string& alias)
+{
+	if (!Content<GLSLFile>::LoadContent(path, alias))
+	{
+		throw std::runtime_error("Failed to load shader: " + path);
+	}
+}
+
+UInt game::CreateComputeProgram(const ShaderCache& cache, const std::string& source, const std::string& defines)
+{
+	std::string glsl = Specialize(Content<GLSLFile>::GetContent(source)->data, defines);
+	auto key = cache.Key({ &glsl });
+
+	UInt program = cache.Load(key);
+	if (program != 0) return program;
+
+	CompiledShader compute(glsl, GL_COMPUTE_SHADER);
+	program = LinkProgram({ compute.shader });
+	cache.Store(key, program);
+	return program;
+}
+
+UInt game::CreateGraphicsProgram(const ShaderCache& cache, const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines)
+{
+	std::string vertex = Specialize(Content<GLSLFile>::GetContent(vertexSource)->data, defines);
+	std::string fragment = Specialize(Content<GLSLFile>::GetContent(fragmentSource)->data, defines);
+	auto key = cache.Key({ &vertex, &fragment });
+
+	UInt program = cache.Load(key);
+	if (program != 0) return program;
+
+	CompiledShader vertexShader(vertex, GL_VERTEX_SHADER);
+	CompiledShader fragmentShader(fragment, GL_FRAGMENT_SHADER);
+	program = LinkProgram({ vertexShader.shader, fragmentShader.shader });
+	cache.Store(key, program);
+	return program;
+}
+
+template <>
+GLSLFile* vlk::ConstructContent(const std::string& path)
+{
+	// Construct instance of MyContent
+	GLSLFile* content = new GLSLFile();
+
+	// Read file contents into object
+	if (!ReadGLSL(path, content->data, 0))
+	{
+		delete content;
+		return nullptr;
+	}
+
+	return content;
+}
+
+template <>
+void vlk::DestroyContent(GLSLFile* file)
+{
+	delete file;
+}
@@ -0,0 +1,173 @@
+#include "ShaderCache.hpp"
+
+#include "glad/glad.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace game;
+
+namespace
+{
+	constexpr char CACHE_MAGIC[4] = { 'F', 'F', 'S', 'C' };
+
+	struct CacheHeader
+	{
+		char magic[4];
+		std::uint32_t binaryFormat;
+		std::uint64_t key;
+		std::uint64_t length;
+	};
+
+	// FNV-1a, stable across runs and platforms unlike std::hash
+	std::uint64_t Hash(std::uint64_t hash, const std::string& data)
+	{
+		for (unsigned char c : data)
+		{
+			hash ^= c;
+			hash *= 0x100000001b3ull;
+		}
+
+		// Separate consecutive strings so "ab" + "c" doesn't collide with "a" + "bc"
+		hash ^= 0xff;
+		hash *= 0x100000001b3ull;
+		return hash;
+	}
+
+	std::string GetString(GLenum name)
+	{
+		const GLubyte* str = glGetString(name);
+		return str ? reinterpret_cast<const char*>(str) : "";
+	}
+}
+
+ShaderCache::ShaderCache(const std::string& _directory) :
+	directory(_directory),
+	enabled(false)
+{
+	Int numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+
+	driver = GetString(GL_VENDOR) + "\n" + GetString(GL_RENDERER) + "\n" + GetString(GL_VERSION);
+
+	if (numFormats == 0)
+	{
+		std::cout << "Driver does not support program binaries, shader cache disabled" << std::endl;
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	enabled = !error;
+
+	if (!enabled)
+	{
+		std::cout << "Failed to create shader cache directory: " << directory << std::endl;
+	}
+}
+
+std::uint64_t ShaderCache::Key(std::initializer_list<const std::string*> sources) const
+{
+	std::uint64_t hash = Hash(0xcbf29ce484222325ull, driver);
+
+	for (const std::string* source : sources)
+	{
+		hash = Hash(hash, *source);
+	}
+
+	return hash;
+}
+
+std::string ShaderCache::PathOf(std::uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return directory + "/" + name;
+}
+
+UInt ShaderCache::Load(std::uint64_t key) const
+{
+	if (!enabled) return 0;
+
+	std::string path = PathOf(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file.good()) return 0;
+
+	std::error_code error;
+	std::uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (error) return 0;
+
+	CacheHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!file.good() ||
+		std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+		header.key != key ||
+		header.length == 0 ||
+		// A truncated or corrupt entry is a miss, not an allocation of whatever length it claims
+		header.length != fileSize - sizeof(header))
+	{
+		return 0;
+	}
+
+	std::vector<char> binary(header.length);
+	file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+	if (!file.good()) return 0;
+
+	UInt program = glCreateProgram();
+	glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	// Drivers are free to reject binaries for any reason, the caller recompiles in that case
+	Int success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+void ShaderCache::Store(std::uint64_t key, UInt program) const
+{
+	if (!enabled) return;
+
+	Int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	CacheHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.key = key;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	header.binaryFormat = format;
+	header.length = static_cast<std::uint64_t>(length);
+
+	// Write to a temporary and rename so a crash never leaves a truncated entry behind
+	std::string path = PathOf(key);
+	std::string temp = path + ".tmp";
+
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), length);
+		if (!file.good())
+		{
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(temp, error);
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temp, path, error);
+	if (error) std::filesystem::remove(temp, error);
+}
@@ -0,0 +1,153 @@
+#include "ShaderCompiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace game;
+
+ShaderCompiler::ShaderCompiler(Window* sharedContext) :
+	context(sharedContext),
+	stopping(false)
+{ }
+
+ShaderCompiler::~ShaderCompiler()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+
+	condition.notify_all();
+	if (worker.joinable()) worker.join();
+
+	for (Job& job : jobs)
+	{
+		if (job.fence != nullptr) glDeleteSync(job.fence);
+	}
+}
+
+UInt ShaderCompiler::Add(std::function<UInt()> compile)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	UInt id = static_cast<UInt>(jobs.size());
+	jobs.push_back({ std::move(compile), JobState::Queued, 0, nullptr, nullptr });
+	queue.push_back(id);
+	condition.notify_all();
+	return id;
+}
+
+void ShaderCompiler::Start()
+{
+	if (context == nullptr || worker.joinable()) return;
+	worker = std::thread(&ShaderCompiler::Run, this);
+}
+
+void ShaderCompiler::Run()
+{
+	context->MakeContextCurrent();
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+		if (stopping) return;
+
+		UInt id = queue.front();
+		queue.pop_front();
+		jobs[id].state = JobState::Compiling;
+
+		// std::deque never moves existing elements on push_back, so the job can be used unlocked
+		Job& job = jobs[id];
+		lock.unlock();
+
+		UInt program = 0;
+		std::exception_ptr error;
+		GLsync fence = nullptr;
+
+		try
+		{
+			program = job.compile();
+			fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		lock.lock();
+		job.program = program;
+		job.fence = fence;
+		job.error = error;
+		job.state = JobState::Done;
+		condition.notify_all();
+	}
+}
+
+bool ShaderCompiler::IsReady(UInt id)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (context != nullptr || jobs[id].state != JobState::Queued) return jobs[id].state == JobState::Done;
+	}
+
+	// Without a worker nothing else would ever compile it, so polling compiles it here
+	Get(id);
+	return true;
+}
+
+UInt ShaderCompiler::Get(UInt id)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	Job& job = jobs[id];
+
+	if (job.state == JobState::Queued)
+	{
+		// The worker hasn't picked it up yet, compiling here is quicker than waiting behind the queue
+		queue.erase(std::find(queue.begin(), queue.end(), id));
+		job.state = JobState::Compiling;
+		lock.unlock();
+
+		UInt program = 0;
+		std::exception_ptr error;
+
+		// Failures are kept like the worker's, so later requests report them instead of waiting forever
+		try
+		{
+			program = job.compile();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		lock.lock();
+		job.program = program;
+		job.error = error;
+		job.state = JobState::Done;
+		condition.notify_all();
+	}
+
+	if (job.state == JobState::Compiling)
+	{
+		std::cout << "Waiting for shader compilation" << std::endl;
+		condition.wait(lock, [&job]() { return job.state == JobState::Done; });
+	}
+
+	if (job.error)
+	{
+		std::rethrow_exception(job.error);
+	}
+
+	if (job.fence != nullptr)
+	{
+		// Make the worker's writes to the program object visible to this context
+		glWaitSync(job.fence, 0, GL_TIMEOUT_IGNORED);
+		glDeleteSync(job.fence);
+		job.fence = nullptr;
+	}
+
+	return job.program;
+}
@@ -0,0 +1,53 @@
+#include "WorkQueue.hpp"
+
+#include "Shader.hpp"
+#include "glad/glad.h"
+
+using namespace game;
+
+namespace
+{
+	// uint numGroups[3], uint count
+	constexpr std::size_t HEADER_SIZE = 16;
+
+	// WorkItem in fractal.glsl: z, w and the pixel, padded to the alignment of its vectors
+	std::size_t ItemSize(PrecisionTier precision)
+	{
+		return GpuPrecision(precision) == PrecisionTier::Double ? 48 : 24;
+	}
+}
+
+WorkQueue::WorkQueue() :
+	buffer(0),
+	capacity(0)
+{
+
+}
+
+WorkQueue::~WorkQueue()
+{
+	if (buffer != 0) glDeleteBuffers(1, &buffer);
+}
+
+void WorkQueue::Reserve(UInt pixels, PrecisionTier precision)
+{
+	std::size_t size = HEADER_SIZE + ItemSize(precision) * pixels;
+	if (size <= capacity) return;
+
+	if (buffer == 0) glGenBuffers(1, &buffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_COPY);
+	capacity = size;
+}
+
+void WorkQueue::Clear()
+{
+	const GLuint header[] = { 0, 1, 1, 0 };
+
+	// The last dispatch may still be updating the header
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+}
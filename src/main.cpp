@@ -2,14 +2,17 @@
 #include "ValkyrieEngine/ValkyrieEngine.hpp"
 
 #include "glad/glad.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 #include "Game.hpp"
 
 using namespace vlk;
 using namespace vlfw;
 
-int main()
+int main(int argc, char** argv)
 {
 	std::cout << "Hello!" << std::endl;
 	VLFWMainArgs args {};
@@ -37,7 +40,49 @@ int main()
 		throw std::runtime_error("Failed to initialize glad");
 	}
 
-	game::Game g(window);
+	// Fractal [levels.pack] [--record <input.log>] [--replay <input.log>] [--gpu-timings]
+	//         [--frame-queue <depth>] [--always-render] [--workgroup <x>x<y>]
+	//         [--ilp <factor>] [--dispatch <grid|two-pass|persistent>] [--first-pass <iterations>]
+	//         [--persistent-groups <count>] [--palette <name>] [--palette-cycle <repeats/s>]
+	//         [--palette-period <dwell>] [--transition <band|fade|dissolve>] [--frame-budget <ms>]
+	//         [--dynamic-resolution <ms>] [--supersample] [--boundary-threshold <dwell>]
+	//         [--accumulate <frames>]
+	game::GameOptions options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		auto value = [&]() -> std::string
+		{
+			if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+			return argv[++i];
+		};
+
+		if (arg == "--record") options.recordPath = value();
+		else if (arg == "--replay") options.replayPath = value();
+		else if (arg == "--gpu-timings") options.printGpuTimings = true;
+		else if (arg == "--always-render") options.renderOnDemand = false;
+		else if (arg == "--workgroup") options.kernel.SetWorkgroupSize(value());
+		else if (arg == "--ilp") options.kernel.ilpFactor = std::max(1ul, std::stoul(value()));
+		else if (arg == "--dispatch") options.kernel.dispatchMode = game::ParseDispatchMode(value());
+		else if (arg == "--first-pass") options.kernel.firstPassIterations = std::max(1ul, std::stoul(value()));
+		else if (arg == "--persistent-groups") options.kernel.persistentGroups = std::max(1ul, std::stoul(value()));
+		else if (arg == "--palette") options.palette = game::ParsePalette(value());
+		else if (arg == "--palette-cycle") options.paletteCycle = std::stof(value());
+		else if (arg == "--palette-period") options.palettePeriod = std::max(1.f, std::stof(value()));
+		else if (arg == "--transition") options.transition = game::ParseTransition(value());
+		else if (arg == "--frame-budget") options.frameBudget = std::max(0.f, std::stof(value()));
+		else if (arg == "--dynamic-resolution") options.resolutionTarget = std::max(0.f, std::stof(value()));
+		else if (arg == "--supersample") options.supersample = true;
+		else if (arg == "--boundary-threshold") options.boundaryThreshold = std::max(0, std::stoi(value()));
+		else if (arg == "--accumulate") options.accumulateFrames = std::stoul(value());
+		else if (arg == "--frame-queue") options.frameQueueDepth = std::stoul(value());
+		else if (arg.compare(0, 2, "--") == 0) throw std::runtime_error("Unknown option: " + arg);
+		else options.levelPack = arg;
+	}
+
+	game::Game g(window, options);
 
 	ApplicationArgs appArgs {};
 	vlk::Application::Start(appArgs);
@@ -0,0 +1,129 @@
+// Checks the CPU kernels against the scalar reference: every formula and precision tier on the
+// SIMD backend, perturbation against direct double-double iteration, and symmetry mirroring
+// against a full render. Exits non-zero if any check fails.
+
+#include "CpuRenderer.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace game;
+
+namespace
+{
+	// Perturbation iterates double deltas, so a pixel on the edge of escaping can land one side
+	// of the bailout where double-double lands on the other
+	constexpr double PERTURBATION_TOLERANCE = 0.01;
+
+	// Off-axis, so no symmetry applies
+	const CpuView SHALLOW_VIEW = { -0.3, 0.1, 1.5, 61, 43 };
+
+	// Deep enough that double gets a different image and some pixels glitch into the fallback
+	const CpuView DEEP_VIEW = { 0.360240443437614, -0.641313061064803, 1e-12, 48, 32 };
+
+	// Centred, with a power of two size and dimensions so mirrored pixel positions are exact
+	const CpuView CENTRED_VIEW = { 0.0, 0.0, 2.0, 64, 32 };
+
+	std::uint32_t failures = 0;
+
+	std::vector<std::int32_t> Render(const CpuRenderParams& params, const CpuView& view, CpuRenderStats* stats = nullptr)
+	{
+		std::vector<std::int32_t> dwell;
+		CpuRenderStats result = RenderDwell(params, view, dwell);
+		if (stats != nullptr) *stats = result;
+		return dwell;
+	}
+
+	std::size_t CountDifferences(const std::vector<std::int32_t>& a, const std::vector<std::int32_t>& b)
+	{
+		std::size_t differences = 0;
+
+		for (std::size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i] != b[i]) differences++;
+		}
+
+		return differences;
+	}
+
+	void Check(const std::string& name, const CpuRenderParams& params, std::size_t differences, std::size_t allowed)
+	{
+		if (differences <= allowed) return;
+
+		std::cout << "FAIL " << name << ": " << FormulaName(params.formula) << ", " << PrecisionTierName(params.precision) <<
+			", " << differences << " pixels differ" << std::endl;
+		failures++;
+	}
+
+	CpuRenderParams ReferenceParams(Formula formula, PrecisionTier precision)
+	{
+		CpuRenderParams params;
+		params.formula = formula;
+		params.precision = precision;
+		params.backend = CpuBackend::Scalar;
+		params.iterations = 200;
+		params.formulaParams.juliaC = { -0.8, 0.156 };
+		params.exploitSymmetry = false;
+		return params;
+	}
+}
+
+int main()
+{
+	for (std::uint32_t f = 0; f < static_cast<std::uint32_t>(Formula::Count); f++)
+	{
+		for (std::uint32_t p = 0; p < static_cast<std::uint32_t>(PrecisionTier::Count); p++)
+		{
+			CpuRenderParams params = ReferenceParams(static_cast<Formula>(f), static_cast<PrecisionTier>(p));
+			std::vector<std::int32_t> scalar = Render(params, SHALLOW_VIEW);
+
+			params.backend = CpuBackend::Simd;
+			Check("SIMD backend", params, CountDifferences(scalar, Render(params, SHALLOW_VIEW)), 0);
+
+			params.exploitSymmetry = false;
+			std::vector<std::int32_t> full = Render(params, CENTRED_VIEW);
+			params.exploitSymmetry = true;
+			Check("symmetry", params, CountDifferences(full, Render(params, CENTRED_VIEW)), 0);
+		}
+	}
+
+	CpuRenderParams params = ReferenceParams(Formula::Mandelbrot, PrecisionTier::DoubleDouble);
+	params.iterations = 1000;
+	std::vector<std::int32_t> reference = Render(params, DEEP_VIEW);
+	std::size_t allowed = static_cast<std::size_t>(reference.size() * PERTURBATION_TOLERANCE);
+
+	params.backend = CpuBackend::Simd;
+	Check("SIMD backend, deep view", params, CountDifferences(reference, Render(params, DEEP_VIEW)), 0);
+
+	params.precision = PrecisionTier::Perturbation;
+	for (CpuBackend backend : { CpuBackend::Scalar, CpuBackend::Simd })
+	{
+		CpuRenderStats stats;
+		params.backend = backend;
+		Check("perturbation", params, CountDifferences(reference, Render(params, DEEP_VIEW, &stats)), allowed);
+
+		if (stats.fallbackPixels == 0)
+		{
+			std::cout << "FAIL perturbation: no pixel took the double-double fallback, the deep view no longer tests it" << std::endl;
+			failures++;
+		}
+	}
+
+	// The deep view is only useful while double precision can't render it
+	params.precision = PrecisionTier::Double;
+	if (CountDifferences(reference, Render(params, DEEP_VIEW)) == 0)
+	{
+		std::cout << "FAIL deep view: double renders it the same as double-double" << std::endl;
+		failures++;
+	}
+
+	if (failures != 0)
+	{
+		std::cout << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All CPU kernel checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}